@@ -0,0 +1,479 @@
+/**
+ * Microbenchmarks for the binding layer, running on a local Lua context and on a Dotnet context backed by the
+ * native mock host (src/dotnet/mock_host.h), so no .NET runtime is needed.
+ * Results are written to stdout as JSON, in the same layout as Google Benchmark's JSON reporter.
+ *
+ * Build it with benchmarks/Makefile (compiles it next to every .cpp under src, with -Wall), on Linux:
+ *   make -C benchmarks
+ *
+ * Usage: embedder_bench [--filter=<substring>] [--min_time=<seconds>]
+ */
+
+#include "Embedder.h"
+#include "dotnet/host.h"
+#include "dotnet/mock_host.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+// The host normally provides the .NET delegates, the benchmarks use the mock host instead.
+void* GetDotnetPointer(int kind)
+{
+    return nullptr;
+}
+
+struct BenchmarkResult
+{
+    std::string name;
+    int64_t iterations;
+    double real_time;
+    double cpu_time;
+};
+
+static std::vector<BenchmarkResult> results;
+static std::string filter;
+static double min_time = 0.5;
+
+// Runs `fn(iterations)` with a growing iteration count until a run takes at least `min_time` seconds.
+static void RunBenchmark(const std::string& name, std::function<void(int64_t)> fn)
+{
+    if (!filter.empty() && name.find(filter) == std::string::npos) return;
+
+    int64_t iterations = 1;
+    for (;;)
+    {
+        std::clock_t cpuStart = std::clock();
+        auto start = std::chrono::steady_clock::now();
+        fn(iterations);
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        double cpuElapsed = (double)(std::clock() - cpuStart) / CLOCKS_PER_SEC;
+
+        if (elapsed >= min_time || iterations >= (int64_t)1 << 32)
+        {
+            results.push_back({ name, iterations, elapsed * 1e9 / iterations, cpuElapsed * 1e9 / iterations });
+            return;
+        }
+
+        double multiplier = elapsed > 0.0 ? (min_time * 1.4) / elapsed : 10.0;
+        if (multiplier > 10.0) multiplier = 10.0;
+        if (multiplier < 2.0) multiplier = 2.0;
+        iterations = (int64_t)(iterations * multiplier);
+    }
+}
+
+static std::string EscapeJSON(const std::string& str)
+{
+    std::string out;
+    for (char c : str)
+    {
+        if (c == '"' || c == '\\') out += '\\';
+        out += c;
+    }
+    return out;
+}
+
+static void PrintResults()
+{
+    char date[64];
+    std::time_t now = std::time(nullptr);
+    std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", std::localtime(&now));
+
+    printf("{\n");
+    printf("  \"context\": {\n");
+    printf("    \"date\": \"%s\",\n", date);
+    printf("    \"executable\": \"embedder_bench\",\n");
+    printf("    \"num_cpus\": %u,\n", std::thread::hardware_concurrency());
+    printf("    \"lua_version\": \"%s\"\n", LUA_RELEASE);
+    printf("  },\n");
+    printf("  \"benchmarks\": [\n");
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        auto& result = results[i];
+        printf("    {\n");
+        printf("      \"name\": \"%s\",\n", EscapeJSON(result.name).c_str());
+        printf("      \"run_name\": \"%s\",\n", EscapeJSON(result.name).c_str());
+        printf("      \"run_type\": \"iteration\",\n");
+        printf("      \"iterations\": %lld,\n", (long long)result.iterations);
+        printf("      \"real_time\": %.4f,\n", result.real_time);
+        printf("      \"cpu_time\": %.4f,\n", result.cpu_time);
+        printf("      \"time_unit\": \"ns\"\n");
+        printf("    }%s\n", i + 1 < results.size() ? "," : "");
+    }
+    printf("  ]\n");
+    printf("}\n");
+}
+
+//////////////////////////////////////////////////////////////
+/////////////////        Lua Helpers           //////////////
+////////////////////////////////////////////////////////////
+
+// Compiles `for i = 1, n do <body> end` once, the benchmark then only pays for running it.
+static EValue CompileLoop(EContext* ctx, const std::string& setup, const std::string& body)
+{
+    lua_State* L = ctx->GetLuaState();
+    std::string code = setup + "\nreturn function(n) for i = 1, n do " + body + " end end";
+    if (luaL_dostring(L, code.c_str()) != LUA_OK)
+    {
+        fprintf(stderr, "failed to compile benchmark: %s\n", lua_tostring(L, -1));
+        lua_pop(L, 1);
+        return EValue(ctx);
+    }
+    return EValue::fromLuaStack(ctx);
+}
+
+static void RunLuaLoop(const std::string& name, EContext* ctx, const std::string& setup, const std::string& body)
+{
+    EValue loop = CompileLoop(ctx, setup, body);
+    RunBenchmark(name, [&](int64_t iterations) {
+        lua_Integer count = iterations;
+        loop(count);
+    });
+}
+
+//////////////////////////////////////////////////////////////
+/////////////////        Bound Natives         //////////////
+////////////////////////////////////////////////////////////
+
+static void NativeNoop(FunctionContext* context) {}
+
+static void NativeAdd(FunctionContext* context)
+{
+    context->SetReturn(context->GetArgument<int>(0) + context->GetArgument<int>(1));
+}
+
+static int BoundAdd(int a, int b)
+{
+    return a + b;
+}
+
+static void NativeHook(FunctionContext* context) {}
+
+static void ClassConstructor(FunctionContext* context, ClassData* data)
+{
+    data->SetData("value", context->GetArgumentOr<int>(0, 0));
+}
+
+static void ClassGet(FunctionContext* context, ClassData* data)
+{
+    context->SetReturn(data->GetData<int>("value"));
+}
+
+static void ClassSet(FunctionContext* context, ClassData* data)
+{
+    data->SetData("value", context->GetArgument<int>(0));
+}
+
+static void RegisterBenchmarkNatives(EContext* ctx)
+{
+    ADD_FUNCTION_NS("bench", "Noop", NativeNoop);
+    ADD_FUNCTION_NS("bench", "Add", NativeAdd);
+    ADD_BINDING_NS("bench", "BoundAdd", &BoundAdd);
+
+    ADD_CLASS("BenchClass");
+    ADD_CLASS_FUNCTION("BenchClass", "BenchClass", ClassConstructor);
+    ADD_CLASS_FUNCTION("BenchClass", "Get", ClassGet);
+    ADD_CLASS_FUNCTION("BenchClass", "Set", ClassSet);
+    ADD_CLASS_MEMBER("BenchClass", "value", ClassGet, ClassSet);
+}
+
+// Kept apart, any hook makes the context take the generic dispatch path for every function.
+static void RegisterBenchmarkHooks(EContext* ctx)
+{
+    ADD_FUNCTION_NS("bench", "OneHook", NativeNoop);
+    ADD_FUNCTION_NS_PRE("bench", "OneHook", NativeHook);
+    ADD_FUNCTION_NS_POST("bench", "OneHook", NativeHook);
+
+    ADD_FUNCTION_NS("bench", "ManyHooks", NativeNoop);
+    for (int i = 0; i < 8; i++)
+    {
+        ADD_FUNCTION_NS_PRE("bench", "ManyHooks", NativeHook);
+        ADD_FUNCTION_NS_POST("bench", "ManyHooks", NativeHook);
+    }
+}
+
+//////////////////////////////////////////////////////////////
+/////////////////         Benchmarks           //////////////
+////////////////////////////////////////////////////////////
+
+static void BenchmarkNativeCalls()
+{
+    EContext* ctx = new EContext(ContextKinds::Lua);
+    RegisterBenchmarkNatives(ctx);
+
+    RunLuaLoop("BM_LuaLoop/Baseline", ctx, "local function f() end", "f()");
+    RunLuaLoop("BM_LuaFunctionCallback/NoHooks", ctx, "local f = bench.Noop", "f()");
+    RunLuaLoop("BM_LuaFunctionCallback/Args2Return1", ctx, "local f = bench.Add", "f(i, 2)");
+    RunLuaLoop("BM_LuaFunctionCallback/Bind/Args2Return1", ctx, "local f = bench.BoundAdd", "f(i, 2)");
+
+    delete ctx;
+
+    ctx = new EContext(ContextKinds::Lua);
+    RegisterBenchmarkHooks(ctx);
+
+    RunLuaLoop("BM_LuaFunctionCallback/Hooks1", ctx, "local f = bench.OneHook", "f()");
+    RunLuaLoop("BM_LuaFunctionCallback/Hooks8", ctx, "local f = bench.ManyHooks", "f()");
+
+    delete ctx;
+}
+
+static void BenchmarkClasses()
+{
+    EContext* ctx = new EContext(ContextKinds::Lua);
+    RegisterBenchmarkNatives(ctx);
+
+    RunLuaLoop("BM_LuaClassFunctionCall/Constructor", ctx, "", "local o = BenchClass(i)");
+    RunLuaLoop("BM_LuaClassFunctionCall/Method", ctx, "local o = BenchClass(1)", "o:Get()");
+    RunLuaLoop("BM_LuaClassFunctionCall/MethodArgs1", ctx, "local o = BenchClass(1)", "o:Set(i)");
+    RunLuaLoop("BM_LuaMemberCallbackIndex/Get", ctx, "local o = BenchClass(1)", "local v = o.value");
+    RunLuaLoop("BM_LuaMemberCallbackNewIndex/Set", ctx, "local o = BenchClass(1)", "o.value = i");
+
+    delete ctx;
+}
+
+static void BenchmarkValues()
+{
+    EContext* ctx = new EContext(ContextKinds::Lua);
+    luaL_dostring(ctx->GetLuaState(), "function bench_identity(a) return a end function bench_noop() end");
+
+    RunBenchmark("BM_EValue/ConstructInt", [&](int64_t iterations) {
+        for (int64_t i = 0; i < iterations; i++) EValue value(ctx, (int)i);
+    });
+
+    RunBenchmark("BM_EValue/ConstructString", [&](int64_t iterations) {
+        std::string str = "benchmark string";
+        for (int64_t i = 0; i < iterations; i++) EValue value(ctx, str);
+    });
+
+    RunBenchmark("BM_EValue/Copy", [&](int64_t iterations) {
+        EValue value(ctx, 42);
+        for (int64_t i = 0; i < iterations; i++) EValue copy(value);
+    });
+
+    RunBenchmark("BM_EValue/CallNoArgs", [&](int64_t iterations) {
+        EValue func = EValue::getGlobal(ctx, "bench_noop");
+        for (int64_t i = 0; i < iterations; i++) func();
+    });
+
+    RunBenchmark("BM_EValue/CallArgs1Cast", [&](int64_t iterations) {
+        EValue func = EValue::getGlobal(ctx, "bench_identity");
+        int sum = 0;
+        for (int i = 0; i < iterations; i++) sum += func(i).cast<int>();
+    });
+
+    RunBenchmark("BM_EValue/CallArgs1Typed", [&](int64_t iterations) {
+        EValue func = EValue::getGlobal(ctx, "bench_identity");
+        int sum = 0;
+        for (int i = 0; i < iterations; i++) sum += func.call<int>(i);
+    });
+
+    RunBenchmark("BM_EPreparedCall/CallNoArgs", [&](int64_t iterations) {
+        EValue func = EValue::getGlobal(ctx, "bench_noop");
+        EPreparedCall<void()> call(func);
+        for (int64_t i = 0; i < iterations; i++) call();
+    });
+
+    RunBenchmark("BM_EPreparedCall/CallArgs1", [&](int64_t iterations) {
+        EValue func = EValue::getGlobal(ctx, "bench_identity");
+        EPreparedCall<int(int)> call(func);
+        int sum = 0;
+        for (int i = 0; i < iterations; i++) sum += call(i);
+    });
+
+    delete ctx;
+}
+
+template <class T>
+static void RunStackRoundTrip(const std::string& name, EContext* ctx, T value)
+{
+    lua_State* L = ctx->GetLuaState();
+    RunBenchmark(name, [&](int64_t iterations) {
+        for (int64_t i = 0; i < iterations; i++)
+        {
+            Stack<T>::pushLua(ctx, value);
+            Stack<T>::getLua(ctx, -1);
+            lua_pop(L, 1);
+        }
+    });
+}
+
+static void BenchmarkStack()
+{
+    EContext* ctx = new EContext(ContextKinds::Lua);
+
+    std::vector<int> vec16(16, 7), vec256(256, 7);
+    std::map<std::string, int> map16;
+    for (int i = 0; i < 16; i++) map16["key" + std::to_string(i)] = i;
+
+    RunStackRoundTrip<int>("BM_StackRoundTrip/int", ctx, 42);
+    RunStackRoundTrip<std::string>("BM_StackRoundTrip/string16", ctx, std::string(16, 'x'));
+    RunStackRoundTrip<std::string>("BM_StackRoundTrip/string1024", ctx, std::string(1024, 'x'));
+    RunStackRoundTrip<std::vector<int>>("BM_StackRoundTrip/vector<int>/16", ctx, vec16);
+    RunStackRoundTrip<std::vector<int>>("BM_StackRoundTrip/vector<int>/256", ctx, vec256);
+    RunStackRoundTrip<std::map<std::string, int>>("BM_StackRoundTrip/map<string,int>/16", ctx, map16);
+
+    delete ctx;
+}
+
+//////////////////////////////////////////////////////////////
+/////////////////       Dotnet (mock host)     //////////////
+////////////////////////////////////////////////////////////
+
+static void ManagedIdentity(EContext* ctx, CallContext& call_ctx)
+{
+    call_ctx.SetReturnType(8);
+    call_ctx.SetResult(call_ctx.GetArgument<int>(0));
+}
+
+// Calls `bench.<function_name>` the way the managed side does, passing `argc` int arguments.
+static void RunDotnetInvoke(const std::string& name, EContext* ctx, const std::string& function_name, int argc)
+{
+    std::string ns = "bench";
+    RunBenchmark(name, [&](int64_t iterations) {
+        CallData data;
+        PrepareMockNativeCall(data, ctx, CallKind::Function, ns, function_name);
+        for (int64_t i = 0; i < iterations; i++)
+        {
+            data.args_count = 1 + argc;
+            data.has_return = 0;
+            for (int arg = 1; arg <= argc; arg++)
+            {
+                data.args_data[arg] = (uint64_t)i;
+                data.args_type[arg] = 8;
+            }
+            Dotnet_InvokeNative(data);
+        }
+        ResetMockDotnetAllocations();
+    });
+}
+
+template <class T>
+static void RunDotnetStackRoundTrip(const std::string& name, EContext* ctx, T value)
+{
+    RunBenchmark(name, [&](int64_t iterations) {
+        for (int64_t i = 0; i < iterations; i++)
+        {
+            void* raw = (void*)Stack<T>::pushRawDotnet(ctx, nullptr, value);
+            T out = Stack<T>::getRawDotnet(ctx, nullptr, &raw);
+        }
+        ResetMockDotnetAllocations();
+    });
+}
+
+static void BenchmarkDotnet()
+{
+    EContext* ctx = new EContext(ContextKinds::Dotnet);
+    RegisterBenchmarkNatives(ctx);
+    RegisterMockManagedFunction("bench_identity", ManagedIdentity);
+
+    RunDotnetInvoke("BM_DotnetInvokeNative/NoHooks", ctx, "Noop", 0);
+    RunDotnetInvoke("BM_DotnetInvokeNative/Args2Return1", ctx, "Add", 2);
+    RunDotnetInvoke("BM_DotnetInvokeNative/Bind/Args2Return1", ctx, "BoundAdd", 2);
+
+    RunBenchmark("BM_DotnetInvokeNative/Direct/Args2Return1", [&](int64_t iterations) {
+        std::string ns = "bench", function_name = "BoundAdd";
+        CallData data;
+        PrepareMockNativeCall(data, ctx, CallKind::ResolveNative, ns, function_name);
+        Dotnet_InvokeNative(data);
+
+        DotnetDirectNative* native = nullptr;
+        memcpy(&native, &data.return_value, sizeof(native));
+
+        int (*direct)(DotnetDirectNative*, int, int) = nullptr;
+        memcpy(&direct, &native->entry, sizeof(direct));
+
+        int sum = 0;
+        for (int64_t i = 0; i < iterations; i++) sum += direct(native, (int)i, 2);
+    });
+
+    RunBenchmark("BM_DotnetEValue/ConstructInt", [&](int64_t iterations) {
+        for (int64_t i = 0; i < iterations; i++) EValue value(ctx, (int)i);
+    });
+
+    RunBenchmark("BM_DotnetEValue/ConstructString", [&](int64_t iterations) {
+        std::string str = "benchmark string";
+        for (int64_t i = 0; i < iterations; i++) EValue value(ctx, str);
+        ResetMockDotnetAllocations();
+    });
+
+    RunBenchmark("BM_DotnetEValue/CallArgs1", [&](int64_t iterations) {
+        EValue func(ctx, (void*)"bench_identity", 17);
+        for (int i = 0; i < iterations; i++) func(i);
+    });
+
+    RunBenchmark("BM_DotnetEValue/FanOut30/Loop", [&](int64_t iterations) {
+        std::vector<EValue> funcs(30, EValue(ctx, (void*)"bench_identity", 17));
+        for (int i = 0; i < iterations; i++)
+            for (auto& func : funcs) func(i);
+    });
+
+    RunBenchmark("BM_DotnetEValue/FanOut30/CallEach", [&](int64_t iterations) {
+        std::vector<EValue> funcs(30, EValue(ctx, (void*)"bench_identity", 17));
+        for (int i = 0; i < iterations; i++) EValue::callEach(funcs, i);
+    });
+
+    RunBenchmark("BM_DotnetEValue/CallString16", [&](int64_t iterations) {
+        EValue func(ctx, (void*)"bench_identity", 17);
+        std::string str(16, 'x');
+        for (int64_t i = 0; i < iterations; i++) func(str);
+        ResetMockDotnetAllocations();
+    });
+
+    RunBenchmark("BM_DotnetEValue/ToStringInt", [&](int64_t iterations) {
+        EValue value(ctx, 123456);
+        size_t total = 0;
+        for (int64_t i = 0; i < iterations; i++) total += value.tostring().size();
+    });
+
+    RunBenchmark("BM_DotnetEValue/ToStringString16", [&](int64_t iterations) {
+        EValue value(ctx, std::string(16, 'x'));
+        size_t total = 0;
+        for (int64_t i = 0; i < iterations; i++) total += value.tostring().size();
+        ResetMockDotnetAllocations();
+    });
+
+    std::vector<int64_t> vec16(16, 7), vec256(256, 7);
+    std::map<std::string, int64_t> map16;
+    for (int i = 0; i < 16; i++) map16["key" + std::to_string(i)] = i;
+
+    RunDotnetStackRoundTrip<std::string>("BM_DotnetStackRoundTrip/string16", ctx, std::string(16, 'x'));
+    RunDotnetStackRoundTrip<std::vector<int64_t>>("BM_DotnetStackRoundTrip/vector<int64>/16", ctx, vec16);
+    RunDotnetStackRoundTrip<std::vector<int64_t>>("BM_DotnetStackRoundTrip/vector<int64>/256", ctx, vec256);
+    RunDotnetStackRoundTrip<std::map<std::string, int64_t>>("BM_DotnetStackRoundTrip/map<string,int64>/16", ctx, map16);
+
+    delete ctx;
+
+    ctx = new EContext(ContextKinds::Dotnet);
+    RegisterBenchmarkHooks(ctx);
+
+    RunDotnetInvoke("BM_DotnetInvokeNative/Hooks1", ctx, "OneHook", 0);
+    RunDotnetInvoke("BM_DotnetInvokeNative/Hooks8", ctx, "ManyHooks", 0);
+
+    delete ctx;
+}
+
+int main(int argc, char** argv)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (arg.rfind("--filter=", 0) == 0) filter = arg.substr(9);
+        else if (arg.rfind("--min_time=", 0) == 0) min_time = std::stod(arg.substr(11));
+    }
+
+    BenchmarkNativeCalls();
+    BenchmarkClasses();
+    BenchmarkValues();
+    BenchmarkStack();
+
+    InitializeMockDotNetAPI();
+    BenchmarkDotnet();
+
+    PrintResults();
+    return 0;
+}
@@ -0,0 +1,142 @@
+#include "Async.h"
+#include "Value.h"
+
+int LuaAsyncContinuation(lua_State* L, int status, lua_KContext kctx)
+{
+    EAsyncOperation* op = (EAsyncOperation*)kctx;
+    if (op->IsRejected()) return luaL_error(L, "%s", op->GetError().c_str());
+    if (op->GetResultCount() > 0 && GetContextByState(L)->AsyncResultsDropped(L))
+        return luaL_error(L, "stack overflow (%d async results)", op->GetResultCount());
+
+    return op->GetResultCount();
+}
+
+// Threads don't share hooks, so coroutines run by the context get the one of the main state.
+void EContext::SyncLuaHook(lua_State* L)
+{
+    lua_State* main = (lua_State*)m_state;
+    if (L == main) return;
+
+    if (lua_gethook(L) != lua_gethook(main) || lua_gethookcount(L) != lua_gethookcount(main))
+        lua_sethook(L, lua_gethook(main), lua_gethookmask(main), lua_gethookcount(main));
+}
+
+std::shared_ptr<EAsyncOperation> EContext::RunAsync(EValue& function)
+{
+    auto completion = std::make_shared<EAsyncOperation>();
+    if (m_kind != ContextKinds::Lua)
+    {
+        completion->Reject("async functions are only supported on Lua contexts");
+        return completion;
+    }
+
+    lua_State* main = (lua_State*)m_state;
+    lua_State* L = lua_newthread(main);
+    int ref = luaL_ref(main, LUA_REGISTRYINDEX);
+    m_asyncThreads[L] = { ref, nullptr, completion };
+
+    lua_rawgeti(L, LUA_REGISTRYINDEX, function.m_ref);
+    ResumeAsync(L, 0);
+    return completion;
+}
+
+void EContext::ResumeAsync(lua_State* L, int args)
+{
+    lua_State* main = (lua_State*)m_state;
+    int status, results = 0;
+    {
+        EScriptCallScope call(this);
+        SyncLuaHook(L);
+        status = lua_resume(L, main, args, &results);
+    }
+
+    auto it = m_asyncThreads.find(L);
+    if (status == LUA_YIELD)
+    {
+        // A plain coroutine.yield leaves `waiting` empty, the coroutine then continues on the next PollAsync.
+        lua_pop(L, results);
+        return;
+    }
+
+    std::shared_ptr<EAsyncOperation> completion = it->second.completion;
+    if (status == LUA_OK)
+    {
+        completion->Resolve();
+    }
+    else
+    {
+        const char* error = lua_tostring(L, -1);
+        luaL_traceback(main, L, error ? error : "Empty error.", 0);
+        completion->Reject(lua_tostring(main, -1));
+        lua_pop(main, 1);
+    }
+
+    luaL_unref(main, LUA_REGISTRYINDEX, it->second.ref);
+    m_asyncThreads.erase(it);
+}
+
+int EContext::PollAsync()
+{
+    if (m_kind != ContextKinds::Lua)
+        return 0;
+
+    // Pollers can add new pollers (a resumed native coroutine awaiting again), which go to the fresh list.
+    std::vector<std::function<bool()>> pollers;
+    pollers.swap(m_asyncPollers);
+    for (auto& poller : pollers)
+    {
+        if (!poller())
+            m_asyncPollers.push_back(std::move(poller));
+    }
+
+    std::vector<lua_State*> ready;
+    for (auto& [L, thread] : m_asyncThreads)
+    {
+        if (!thread.waiting || thread.waiting->IsDone())
+            ready.push_back(L);
+    }
+
+    for (lua_State* L : ready)
+    {
+        std::shared_ptr<EAsyncOperation> op = std::move(m_asyncThreads[L].waiting);
+
+        int args = 0;
+        bool dropped = false;
+        if (op && !op->IsRejected())
+        {
+            if (lua_checkstack(L, op->GetResultCount()))
+            {
+                EActiveStateScope active(this, L);
+                args = op->PushResults(this);
+            }
+            else dropped = true;
+        }
+        m_asyncThreads[L].resultsDropped = dropped;
+        ResumeAsync(L, args);
+    }
+
+    return (int)m_asyncThreads.size();
+}
+
+void EContext::AddAsyncPoller(std::function<bool()> poller)
+{
+    m_asyncPollers.push_back(std::move(poller));
+}
+
+bool EContext::IsAsyncThread(lua_State* L)
+{
+    return m_asyncThreads.find(L) != m_asyncThreads.end();
+}
+
+void EContext::SuspendAsync(lua_State* L, std::shared_ptr<EAsyncOperation> op)
+{
+    auto it = m_asyncThreads.find(L);
+    if (it != m_asyncThreads.end())
+        it->second.waiting = std::move(op);
+}
+
+bool EContext::AsyncResultsDropped(lua_State* L)
+{
+    auto it = m_asyncThreads.find(L);
+    return it != m_asyncThreads.end() && it->second.resultsDropped;
+}
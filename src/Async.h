@@ -0,0 +1,232 @@
+#ifndef _embedder_internal_async_h
+#define _embedder_internal_async_h
+
+#include <lua.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <string>
+
+#include "Context.h"
+#include "Stack.h"
+
+// Something a suspended Lua coroutine waits on (see FunctionContext::Suspend and EContext::RunAsync).
+// It can be completed from any thread, the coroutine itself is only resumed by EContext::PollAsync.
+class EAsyncOperation
+{
+private:
+    enum State
+    {
+        Pending,
+        Completing,
+        Resolved,
+        Rejected,
+    };
+
+    std::atomic<int> m_state{ Pending };
+    std::function<void(EContext*)> m_push;
+    int m_results = 0;
+    std::string m_error;
+
+    bool BeginCompletion()
+    {
+        int expected = Pending;
+        return m_state.compare_exchange_strong(expected, Completing, std::memory_order_acquire);
+    }
+
+public:
+    // The values become the results of the suspended native. Returns false if the operation was already completed.
+    template<typename... T>
+    bool Resolve(T... values)
+    {
+        if (!BeginCompletion()) return false;
+
+        if constexpr (sizeof...(T) > 0) {
+            m_push = [values...](EContext* ctx) mutable {
+                (Stack<T>::pushLua(ctx, values), ...);
+            };
+        }
+        m_results = sizeof...(T);
+        m_state.store(Resolved, std::memory_order_release);
+        return true;
+    }
+
+    // Raised as a Lua error inside the suspended coroutine.
+    bool Reject(std::string error)
+    {
+        if (!BeginCompletion()) return false;
+
+        m_error = std::move(error);
+        m_state.store(Rejected, std::memory_order_release);
+        return true;
+    }
+
+    bool IsDone() const
+    {
+        int state = m_state.load(std::memory_order_acquire);
+        return state == Resolved || state == Rejected;
+    }
+
+    bool IsRejected() const
+    {
+        return m_state.load(std::memory_order_acquire) == Rejected;
+    }
+
+    // Only meaningful once the operation is rejected.
+    const std::string& GetError() const
+    {
+        return m_error;
+    }
+
+    int GetResultCount() const
+    {
+        return m_results;
+    }
+
+    // Pushes the resolved values on the context's active state.
+    int PushResults(EContext* ctx)
+    {
+        if (m_push) m_push(ctx);
+        return m_results;
+    }
+};
+
+// Continuation of a native suspended through FunctionContext::Suspend.
+int LuaAsyncContinuation(lua_State* L, int status, lua_KContext kctx);
+
+// Completes with the value of `future`, checked every EContext::PollAsync.
+template<typename T>
+std::shared_ptr<EAsyncOperation> EAsyncFromFuture(EContext* ctx, std::future<T> future)
+{
+    auto op = std::make_shared<EAsyncOperation>();
+    auto shared = std::make_shared<std::future<T>>(std::move(future));
+
+    ctx->AddAsyncPoller([op, shared]() {
+        if (shared->wait_for(std::chrono::seconds(0)) != std::future_status::ready) return false;
+
+        try {
+            if constexpr (std::is_void<T>::value) {
+                shared->get();
+                op->Resolve();
+            }
+            else op->Resolve(shared->get());
+        }
+        catch (std::exception& e) {
+            op->Reject(e.what());
+        }
+        return true;
+    });
+    return op;
+}
+
+//////////////////////////////////////////////////////////////
+/////////////////    C++20 Native Coroutines   //////////////
+////////////////////////////////////////////////////////////
+
+#if defined(__cpp_impl_coroutine)
+#include <coroutine>
+
+// Lets the native side of an async function be written as a C++20 coroutine:
+//
+//   ENativeTask<int> CountPlayers(EContext* ctx) { auto rows = co_await EAwaitFuture(ctx, QueryAsync()); co_return rows.size(); }
+//   void Native(FunctionContext* fctx) { fctx->Suspend(CountPlayers(fctx->GetPluginContext()).GetOperation()); }
+//
+// The task starts right away, co_return resolves its operation and an escaping exception rejects it.
+template<typename T>
+class ENativeTask;
+
+template<typename T>
+struct ENativePromiseBase
+{
+    std::shared_ptr<EAsyncOperation> m_op = std::make_shared<EAsyncOperation>();
+
+    std::suspend_never initial_suspend() noexcept { return {}; }
+    std::suspend_never final_suspend() noexcept { return {}; }
+
+    void unhandled_exception()
+    {
+        try {
+            throw;
+        }
+        catch (std::exception& e) {
+            m_op->Reject(e.what());
+        }
+        catch (...) {
+            m_op->Reject("unknown exception in native coroutine");
+        }
+    }
+};
+
+template<typename T>
+class ENativeTask
+{
+public:
+    struct promise_type : ENativePromiseBase<T>
+    {
+        ENativeTask get_return_object() { return ENativeTask(this->m_op); }
+        void return_value(T value) { this->m_op->Resolve(std::move(value)); }
+    };
+
+    explicit ENativeTask(std::shared_ptr<EAsyncOperation> op) : m_op(std::move(op)) {}
+    std::shared_ptr<EAsyncOperation> GetOperation() { return m_op; }
+
+private:
+    std::shared_ptr<EAsyncOperation> m_op;
+};
+
+template<>
+class ENativeTask<void>
+{
+public:
+    struct promise_type : ENativePromiseBase<void>
+    {
+        ENativeTask get_return_object() { return ENativeTask(this->m_op); }
+        void return_void() { this->m_op->Resolve(); }
+    };
+
+    explicit ENativeTask(std::shared_ptr<EAsyncOperation> op) : m_op(std::move(op)) {}
+    std::shared_ptr<EAsyncOperation> GetOperation() { return m_op; }
+
+private:
+    std::shared_ptr<EAsyncOperation> m_op;
+};
+
+// co_await on a std::future, the coroutine is resumed by the EContext::PollAsync that sees it ready.
+template<typename T>
+class EAwaitFuture
+{
+private:
+    EContext* m_ctx;
+    std::future<T> m_future;
+
+public:
+    EAwaitFuture(EContext* ctx, std::future<T> future) : m_ctx(ctx), m_future(std::move(future)) {}
+
+    bool await_ready()
+    {
+        return m_future.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+    }
+
+    void await_suspend(std::coroutine_handle<> handle)
+    {
+        std::future<T>* future = &m_future;
+        m_ctx->AddAsyncPoller([future, handle]() {
+            if (future->wait_for(std::chrono::seconds(0)) != std::future_status::ready) return false;
+
+            handle.resume();
+            return true;
+        });
+    }
+
+    T await_resume()
+    {
+        return m_future.get();
+    }
+};
+#endif
+
+#endif
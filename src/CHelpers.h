@@ -8,6 +8,7 @@
 #include <vector>
 
 #include "GarbageCollector.h"
+#include "Helpers.h"
 #include "engine/classes.h"
 
 class CHelpers
@@ -134,12 +135,71 @@ public:
         // no return
     }
 
+    // Pushes the namespace table for namespace_path ("_G" or "a.b.c"), creating the missing ones along the way.
+    // A namespace created here gets room for nrec fields.
+    static void pushNamespace(lua_State* L, const std::string& namespace_path, int nrec = 0)
+    {
+        lua_pushglobaltable(L); // _G
+        if (namespace_path == "_G" || namespace_path.empty())
+            return;
+
+        size_t pos_start = 0;
+        while (pos_start <= namespace_path.size())
+        {
+            size_t pos_end = namespace_path.find('.', pos_start);
+            bool last = pos_end == std::string::npos;
+            std::string path = namespace_path.substr(pos_start, last ? std::string::npos : pos_end - pos_start);
+
+            rawgetfield(L, -1, path.c_str()); // pns, ns | nil
+
+            // A library still pending in a lazy context is opened, not shadowed by a new table.
+            if (lua_isnil(L, -1) && pos_start == 0 && OpenLazyLuaLib(L, path.c_str()))
+                lua_remove(L, -2); // pns, lib
+
+            if (lua_isnil(L, -1))
+            {
+                lua_pop(L, 1);
+
+                lua_createtable(L, 0, last ? nrec : 0); // pns, ns
+
+                lua_pushvalue(L, -1); // pns, ns, ns
+
+                // ns.__metatable = ns
+                lua_setmetatable(L, -2); // pns, ns
+
+                // ns.__index = indexMetaMethod
+                lua_pushcfunction(L, &CHelpers::indexMetaMethod);
+                rawsetfield(L, -2, "__index"); // pns, ns
+
+                // ns.__newindex = newindexMetaMethod
+                lua_pushcfunction(L, &CHelpers::newindexStaticMetaMethod);
+                rawsetfield(L, -2, "__newindex"); // pns, ns
+
+                lua_newtable(L);                     // pns, ns, propget table (pg)
+                lua_rawsetp(L, -2, getPropgetKey()); // ns [propgetKey] = pg. pns, ns
+
+                lua_newtable(L);                     // pns, ns, propset table (ps)
+                lua_rawsetp(L, -2, getPropsetKey()); // ns [propsetKey] = ps. pns, ns
+
+                // pns [name] = ns
+                lua_pushvalue(L, -1);             // pns, ns, ns
+                rawsetfield(L, -3, path.c_str()); // pns, ns
+            }
+
+            lua_remove(L, -2); // ns
+
+            if (last)
+                break;
+            pos_start = pos_end + 1;
+        }
+    }
+
     static int LuaGCFunction(lua_State* L)
     {
         ClassData** udata = (ClassData**)lua_touserdata(L, 1);
         if (udata && *udata) {
             std::vector<ClassData**> udatas = (*udata)->GetDataOr<std::vector<ClassData**>>("lua_udatas", std::vector<ClassData**>{});
-            for (int i = 0; i < udatas.size(); i++) {
+            for (size_t i = 0; i < udatas.size(); i++) {
                 if (udatas[i] == udata) {
                     udatas.erase(udatas.begin() + i);
                     break;
@@ -155,11 +215,11 @@ public:
         return 0;
     }
 
-    static void DotNetGCFunction(EContext* ctx, ClassData* data, std::set<void*>* droppedValues)
+    // Only called from DrainDotnetFinalizers. The delete-on-GC set doubles as the table of live copies owned by
+    // managed code, so a finalization reported twice, or for an address that is no longer one of them, is ignored.
+    static void DotNetGCFunction(EContext* ctx, ClassData* data)
     {
         if (data && CheckAndPopDeleteOnGC(data)) {
-            if (droppedValues->find(data) != droppedValues->end()) return;
-            droppedValues->insert(data);
             delete data;
         }
     }
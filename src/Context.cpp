@@ -2,25 +2,111 @@
 #include "Exception.h"
 #include "Helpers.h"
 #include "CHelpers.h"
+#include "GarbageCollector.h"
 #include "dotnet/host.h"
 
 #include <set>
 #include <filesystem>
 #include <regex>
+#include <chrono>
 
-static const luaL_Reg lualibs[] = {
-    {"_G", luaopen_base},
-    {LUA_TABLIBNAME, luaopen_table},
-    {LUA_STRLIBNAME, luaopen_string},
-    {LUA_MATHLIBNAME, luaopen_math},
-    {LUA_DBLIBNAME, luaopen_debug},
-    {LUA_COLIBNAME, luaopen_coroutine},
-    {LUA_UTF8LIBNAME, luaopen_utf8},
-    {LUA_IOLIBNAME, luaopen_io},
-    {LUA_OSLIBNAME, luaopen_os},
-    {NULL, NULL},
+struct LuaLib
+{
+    int flag;
+    const char* name;
+    lua_CFunction func;
+};
+
+static const LuaLib lualibs[] = {
+    {LuaLib_Base, "_G", luaopen_base},
+    {LuaLib_Table, LUA_TABLIBNAME, luaopen_table},
+    {LuaLib_String, LUA_STRLIBNAME, luaopen_string},
+    {LuaLib_Math, LUA_MATHLIBNAME, luaopen_math},
+    {LuaLib_Debug, LUA_DBLIBNAME, luaopen_debug},
+    {LuaLib_Coroutine, LUA_COLIBNAME, luaopen_coroutine},
+    {LuaLib_UTF8, LUA_UTF8LIBNAME, luaopen_utf8},
+    {LuaLib_IO, LUA_IOLIBNAME, luaopen_io},
+    {LuaLib_OS, LUA_OSLIBNAME, luaopen_os},
+    {0, NULL, NULL},
 };
 
+bool OpenLazyLuaLib(lua_State* L, const char* name)
+{
+    if (lua_rawgetp(L, LUA_REGISTRYINDEX, getLazyLibsKey()) != LUA_TTABLE) // pending | nil
+    {
+        lua_pop(L, 1);
+        return false;
+    }
+
+    rawgetfield(L, -1, name);                            // pending, opener | nil
+    if (!lua_iscfunction(L, -1))
+    {
+        lua_pop(L, 2);
+        return false;
+    }
+
+    lua_CFunction func = lua_tocfunction(L, -1);
+    lua_pop(L, 1);                                       // pending
+
+    lua_pushnil(L);
+    rawsetfield(L, -2, name);                            // pending[name] = nil
+    lua_pop(L, 1);                                       // empty
+
+    luaL_requiref(L, name, func, 1);                     // module, also set as _G[name]
+    return true;
+}
+
+static void OpenAllLazyLuaLibs(lua_State* L)
+{
+    if (lua_rawgetp(L, LUA_REGISTRYINDEX, getLazyLibsKey()) != LUA_TTABLE) // pending | nil
+    {
+        lua_pop(L, 1);
+        return;
+    }
+
+    std::vector<std::string> names;
+    lua_pushnil(L);
+    while (lua_next(L, -2) != 0)
+    {
+        if (lua_type(L, -2) == LUA_TSTRING)
+            names.push_back(lua_tostring(L, -2));
+        lua_pop(L, 1);
+    }
+    lua_pop(L, 1);                                       // empty
+
+    for (auto& name : names)
+    {
+        if (OpenLazyLuaLib(L, name.c_str()))
+            lua_pop(L, 1);
+    }
+}
+
+// _G.__index, opens a lazily registered library the first time its global is read.
+static int LazyLibIndex(lua_State* L)
+{
+    if (lua_type(L, 2) != LUA_TSTRING)
+        return 0;
+
+    return OpenLazyLuaLib(L, lua_tostring(L, 2)) ? 1 : 0;
+}
+
+// setmetatable of contexts with lazy libraries. Replacing the metatable of _G would drop LazyLibIndex,
+// so the libraries still pending are opened first. Upvalue 1 is the original setmetatable.
+static int LazyLibSetMetatable(lua_State* L)
+{
+    lua_pushglobaltable(L);
+    bool globals = lua_rawequal(L, 1, -1);
+    lua_pop(L, 1);
+    if (globals)
+        OpenAllLazyLuaLibs(L);
+
+    int args = lua_gettop(L);
+    lua_pushvalue(L, lua_upvalueindex(1));
+    lua_insert(L, 1);
+    lua_call(L, args, LUA_MULTRET);
+    return lua_gettop(L);
+}
+
 void CheckAndPopulateRegexFunctions(std::map<std::string, std::vector<void*>>& validCalls, std::map<std::string, std::vector<void*>>& calls, std::map<std::string, void*>& functions, std::string function_key, bool forceRegenerate = false) {
     for (auto it = functions.begin(); it != functions.end(); ++it) {
         try {
@@ -45,23 +131,36 @@ void CheckAndPopulateRegexFunctionsPair(std::map<std::string, std::vector<std::p
     }
 }
 
-EContext::EContext(ContextKinds kind)
+EContext::EContext(ContextKinds kind, int libraries, bool lazyLibraries)
 {
     m_kind = kind;
+    m_libraries = libraries;
+    m_lazyLibraries = lazyLibraries;
 
     if (kind == ContextKinds::Lua)
     {
         auto state = luaL_newstate();
         m_state = (void*)state;
 
-        const luaL_Reg* lib = lualibs;
+        const LuaLib* lib = lualibs;
         for (; lib->func; lib++)
-            RegisterLuaLib(lib->name, lib->func);
+        {
+            if ((libraries & lib->flag) == 0)
+                continue;
+
+            // String methods go through the string metatable, which only exists once the library is opened.
+            if (lazyLibraries && lib->flag != LuaLib_Base && lib->flag != LuaLib_String)
+                RegisterLazyLuaLib(lib->name, lib->func);
+            else
+                RegisterLuaLib(lib->name, lib->func);
+        }
 
         lua_pushglobaltable(state);                 // _G
         lua_pushlightuserdata(state, (void*)this); // _G, ud
         lua_rawsetp(state, -2, getContextKey());    // _G[key] = ud. _G
         lua_pop(state, 1);                          // empty
+
+        RegisterGCContext(this);
     }
     else if (kind == ContextKinds::Dotnet) {
         InitializeDotNetAPI();
@@ -72,18 +171,26 @@ EContext::EContext(ContextKinds kind)
 
 EContext::~EContext()
 {
-    for (auto it = mappedValues.begin(); it != mappedValues.end(); ++it)
-        delete (*it);
-
+    // EValues are owned by whoever holds them (locals, members) and have to be destroyed before their context,
+    // the ones still mapped here aren't the context's to free.
     mappedValues.clear();
 
     if (m_kind == ContextKinds::Lua)
     {
+        UnregisterGCContext(this);
         lua_close((lua_State*)m_state);
     }
     else if (m_kind == ContextKinds::Dotnet)
     {
+        // Unloading finalizes most of the plugin's objects, destroy them while the context still exists.
+        // The CLR can still report some later, those no longer call back into it.
         RemoveDotnetFile(this);
+        DrainDotnetFinalizers(this);
+        DetachDeleteOnGC(this);
+
+        // The pressure is process wide, give back what this plugin still accounts for.
+        if (m_reportedMemoryPressure != 0) DotnetUpdateMemoryPressure(this, -m_reportedMemoryPressure);
+        m_reportedMemoryPressure = 0;
     }
 }
 
@@ -98,6 +205,40 @@ void EContext::RegisterLuaLib(const char* libName, lua_CFunction func)
     lua_pop((lua_State*)m_state, 1);
 }
 
+void EContext::RegisterLazyLuaLib(const char* libName, lua_CFunction func)
+{
+    auto L = (lua_State*)m_state;
+
+    if (lua_rawgetp(L, LUA_REGISTRYINDEX, getLazyLibsKey()) == LUA_TNIL)
+    {
+        lua_pop(L, 1);
+
+        lua_newtable(L);                                     // pending
+        lua_pushvalue(L, -1);                                // pending, pending
+        lua_rawsetp(L, LUA_REGISTRYINDEX, getLazyLibsKey()); // pending
+
+        lua_pushglobaltable(L);                              // pending, _G
+        lua_newtable(L);                                     // pending, _G, mt
+        lua_pushcfunction(L, LazyLibIndex);
+        rawsetfield(L, -2, "__index");                       // pending, _G, mt
+        lua_setmetatable(L, -2);                             // pending, _G
+
+        rawgetfield(L, -1, "setmetatable");                  // pending, _G, setmetatable | nil
+        if (lua_iscfunction(L, -1))
+        {
+            lua_pushcclosure(L, LazyLibSetMetatable, 1);     // pending, _G, wrapper
+            rawsetfield(L, -2, "setmetatable");              // pending, _G
+        }
+        else
+            lua_pop(L, 1);                                   // pending, _G
+        lua_pop(L, 1);                                       // pending
+    }
+
+    lua_pushcfunction(L, func);
+    rawsetfield(L, -2, libName);                             // pending[name] = func
+    lua_pop(L, 1);                                           // empty
+}
+
 int64_t EContext::GetMemoryUsage()
 {
     if (m_kind == ContextKinds::Lua)
@@ -109,12 +250,195 @@ int64_t EContext::GetMemoryUsage()
     }
     else if (m_kind == ContextKinds::Dotnet)
     {
-        return GetDotnetRuntimeMemoryUsage(this);
+        return GetDotnetRuntimeMemoryUsage(this) + m_nativeMemory;
     }
     else
         return 0;
 }
 
+void EContext::AddNativeMemory(int64_t delta)
+{
+    m_nativeMemory += delta;
+    if (m_kind != ContextKinds::Dotnet) return;
+
+    int64_t pending = m_nativeMemory - m_reportedMemoryPressure;
+    if (pending < DOTNET_MEMORY_PRESSURE_STEP && pending > -DOTNET_MEMORY_PRESSURE_STEP) return;
+
+    DotnetUpdateMemoryPressure(this, pending);
+    m_reportedMemoryPressure += pending;
+}
+
+int64_t EContext::GetNativeMemoryUsage()
+{
+    return m_nativeMemory;
+}
+
+int64_t EContext::StepGarbageCollector(int64_t budget_us)
+{
+    if (m_kind != ContextKinds::Lua || budget_us <= 0)
+        return 0;
+
+    auto L = (lua_State*)m_state;
+    int64_t budget_ns = budget_us * 1000;
+    auto start = std::chrono::steady_clock::now();
+    int64_t elapsed = 0;
+
+    while (elapsed < budget_ns)
+    {
+        auto stepStart = std::chrono::steady_clock::now();
+        int finished = lua_gc(L, LUA_GCSTEP, (size_t)m_gcStepSize);
+        auto now = std::chrono::steady_clock::now();
+
+        int64_t stepTime = std::chrono::duration_cast<std::chrono::nanoseconds>(now - stepStart).count();
+        elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(now - start).count();
+
+        // Keep a single step around a quarter of the budget, so the last one doesn't overshoot it.
+        if (stepTime * 4 < budget_ns && m_gcStepSize < (1 << 20))
+            m_gcStepSize *= 2;
+        else if (stepTime * 2 > budget_ns && m_gcStepSize > 1)
+            m_gcStepSize /= 2;
+
+        if (finished)
+            break;
+    }
+
+    return elapsed / 1000;
+}
+
+void EContext::SetManualGarbageCollection(bool state)
+{
+    if (m_kind != ContextKinds::Lua)
+        return;
+
+    lua_gc((lua_State*)m_state, state ? LUA_GCSTOP : LUA_GCRESTART);
+}
+
+static void ContextLuaHook(lua_State* L, lua_Debug* ar)
+{
+    EContext* ctx = GetContextByState(L);
+    if (ctx) ctx->OnLuaHook(L, ar);
+}
+
+// Every per-context feature driven by the count hook shares one hook, installed only while one of them is active.
+void EContext::UpdateLuaHook()
+{
+    if (m_kind != ContextKinds::Lua)
+        return;
+
+    int count = 0;
+    if (m_profilerRunning) count = m_profilerPeriod;
+    if ((m_budgetInstructions > 0 || m_budgetTime > 0) && (count == 0 || m_budgetCheckPeriod < count)) count = m_budgetCheckPeriod;
+
+    if (count == m_hookCount)
+        return;
+
+    m_hookCount = count;
+    if (count > 0)
+        lua_sethook((lua_State*)m_state, ContextLuaHook, LUA_MASKCOUNT, count);
+    else
+        lua_sethook((lua_State*)m_state, nullptr, 0, 0);
+}
+
+void EContext::OnLuaHook(lua_State* L, lua_Debug* ar)
+{
+    if (ar->event != LUA_HOOKCOUNT)
+        return;
+
+    int count = lua_gethookcount(L);
+    if (m_budgetExceeded && m_scriptCallDepth > 0)
+        return CheckScriptBudget(L, count);
+
+    // Threads keep the hook they had when they were created, bring them in line with the current one.
+    if (count != m_hookCount)
+    {
+        if (m_hookCount <= 0)
+            return lua_sethook(L, nullptr, 0, 0);
+
+        lua_sethook(L, ContextLuaHook, LUA_MASKCOUNT, m_hookCount);
+    }
+
+    if (m_profilerRunning)
+    {
+        m_profilerInstructions += count;
+        if (m_profilerInstructions >= m_profilerPeriod)
+        {
+            m_profilerInstructions = 0;
+            SampleScriptProfiler(L);
+        }
+    }
+
+    if (m_scriptCallDepth > 0 && (m_budgetInstructions > 0 || m_budgetTime > 0))
+        CheckScriptBudget(L, count);
+}
+
+void EContext::SetScriptBudget(int64_t max_instructions, int64_t max_time_us, int check_period)
+{
+    m_budgetInstructions = max_instructions > 0 ? max_instructions : 0;
+    m_budgetTime = max_time_us > 0 ? max_time_us : 0;
+    m_budgetCheckPeriod = check_period > 0 ? check_period : 1000;
+    UpdateLuaHook();
+}
+
+void EContext::GetScriptBudget(int64_t& max_instructions, int64_t& max_time_us)
+{
+    max_instructions = m_budgetInstructions;
+    max_time_us = m_budgetTime;
+}
+
+void EContext::GetScriptBudget(int64_t& max_instructions, int64_t& max_time_us, int& check_period)
+{
+    GetScriptBudget(max_instructions, max_time_us);
+    check_period = m_budgetCheckPeriod;
+}
+
+void EContext::BeginScriptCall()
+{
+    if (m_scriptCallDepth++ == 0)
+    {
+        m_budgetUsed = 0;
+        if (m_budgetTime > 0)
+            m_budgetStart = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+}
+
+void EContext::EndScriptCall()
+{
+    if (m_scriptCallDepth > 0 && --m_scriptCallDepth == 0 && m_budgetExceeded)
+    {
+        m_budgetExceeded = false;
+
+        // Put back the regular hook period, the exceeded budget switched it to every instruction.
+        m_hookCount = -1;
+        UpdateLuaHook();
+    }
+}
+
+// Once over budget, the hook runs on every instruction and raises each time,
+// so the error can't be swallowed by a pcall inside the script.
+void EContext::CheckScriptBudget(lua_State* L, int count)
+{
+    m_budgetUsed += count;
+
+    bool overInstructions = m_budgetInstructions > 0 && m_budgetUsed > m_budgetInstructions;
+    bool overTime = false;
+    if (!overInstructions && m_budgetTime > 0)
+    {
+        int64_t now = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+        overTime = now - m_budgetStart > m_budgetTime;
+    }
+
+    if (!overInstructions && !overTime && !m_budgetExceeded)
+        return;
+
+    m_budgetExceeded = true;
+    lua_sethook(L, ContextLuaHook, LUA_MASKCOUNT, 1);
+
+    if (m_budgetTime > 0 && !overInstructions)
+        luaL_error(L, "script exceeded its time budget (%I us)", (lua_Integer)m_budgetTime);
+    else
+        luaL_error(L, "script exceeded its instruction budget (%I instructions)", (lua_Integer)m_budgetInstructions);
+}
+
 std::string files_Read(std::string path)
 {
     if (!std::filesystem::exists(path))
@@ -135,9 +459,10 @@ int EContext::RunFile(std::string path)
 {
     if (m_kind == ContextKinds::Lua)
     {
+        EScriptCallScope call(this);
         int cd = (luaL_dofile((lua_State*)m_state, path.c_str()));
         if (cd != 0)
-            EException::Throw(EException(GetState(), GetKind(), cd));
+            EException::Throw(EException(m_state, GetKind(), cd));
         return cd;
     }
     else if (m_kind == ContextKinds::Dotnet)
@@ -164,17 +489,35 @@ void EContext::PopValue(EValue* val)
 
 void* EContext::GetState()
 {
-    return m_state;
+    return m_activeState ? m_activeState : m_state;
 }
 
 lua_State* EContext::GetLuaState()
+{
+    return (lua_State*)GetState();
+}
+
+lua_State* EContext::GetMainLuaState()
 {
     return (lua_State*)m_state;
 }
 
+void* EContext::SetActiveState(void* state)
+{
+    void* prev = m_activeState;
+    m_activeState = (state == m_state) ? nullptr : state;
+    return prev;
+}
+
 void EContext::AddFunctionCall(std::string key, void* val)
 {
     functionCalls.insert_or_assign(key, val);
+    // A thunk belongs to the binding registered before, the last registration wins (AddScriptingBinding adds its own after).
+    functionDotnetThunks.erase(key);
+    RetireDotnetDirect(functionDotnetDirect, key);
+
+    if (key == "_G OnFunctionContextRegister" || key == "_G OnFunctionContextUnregister")
+        m_functionHooks = true;
 }
 
 void* EContext::GetFunctionCall(std::string key)
@@ -184,8 +527,69 @@ void* EContext::GetFunctionCall(std::string key)
     return functionCalls[key];
 }
 
+void EContext::AddFunctionDotnetThunk(std::string key, void* val)
+{
+    functionDotnetThunks.insert_or_assign(key, val);
+}
+
+void* EContext::GetFunctionDotnetThunk(std::string key)
+{
+    auto it = functionDotnetThunks.find(key);
+    if (it == functionDotnetThunks.end())
+        return nullptr;
+    return it->second;
+}
+
+void EContext::RetireDotnetDirect(std::map<std::string, std::unique_ptr<DotnetDirectNative>>& records, const std::string& key)
+{
+    auto it = records.find(key);
+    if (it == records.end())
+        return;
+
+    it->second->retired = true;
+    retiredDotnetDirect.push_back(std::move(it->second));
+    records.erase(it);
+}
+
+void EContext::AddFunctionDotnetDirect(std::string namespace_path, std::string function_name, void* entry)
+{
+    std::string key = namespace_path + " " + function_name;
+    RetireDotnetDirect(functionDotnetDirect, key);
+    functionDotnetDirect[key].reset(new DotnetDirectNative{ entry, this, namespace_path, function_name, key });
+}
+
+DotnetDirectNative* EContext::GetFunctionDotnetDirect(std::string key)
+{
+    auto it = functionDotnetDirect.find(key);
+    if (it == functionDotnetDirect.end())
+        return nullptr;
+    return it->second.get();
+}
+
+void EContext::AddClassFunctionDotnetDirect(std::string class_name, std::string function_name, void* entry)
+{
+    std::string key = class_name + " " + function_name;
+    RetireDotnetDirect(classFunctionDotnetDirect, key);
+    classFunctionDotnetDirect[key].reset(new DotnetDirectNative{ entry, this, class_name, function_name, key });
+}
+
+DotnetDirectNative* EContext::GetClassFunctionDotnetDirect(std::string key)
+{
+    auto it = classFunctionDotnetDirect.find(key);
+    if (it == classFunctionDotnetDirect.end())
+        return nullptr;
+    return it->second.get();
+}
+
+bool EContext::HasFunctionHooks()
+{
+    return m_functionHooks;
+}
+
 void EContext::AddFunctionPreCall(std::string key, void* val)
 {
+    m_functionHooks = true;
+
     if (functionPreCalls.find(key) == functionPreCalls.end())
         functionPreCalls.insert({ key, {} });
 
@@ -200,6 +604,8 @@ std::vector<void*> EContext::GetFunctionPreCalls(std::string str_key)
 
 void EContext::AddFunctionPostCall(std::string key, void* val)
 {
+    m_functionHooks = true;
+
     if (functionPostCalls.find(key) == functionPostCalls.end())
         functionPostCalls.insert({ key, {} });
 
@@ -215,6 +621,7 @@ std::vector<void*> EContext::GetFunctionPostCalls(std::string str_key)
 void EContext::AddClassFunctionCalls(std::string key, void* val)
 {
     classFunctionCalls.insert_or_assign(key, val);
+    RetireDotnetDirect(classFunctionDotnetDirect, key);
 }
 
 void* EContext::GetClassFunctionCall(std::string key)
@@ -224,8 +631,15 @@ void* EContext::GetClassFunctionCall(std::string key)
     return classFunctionCalls[key];
 }
 
+bool EContext::HasClassFunctionHooks()
+{
+    return m_classFunctionHooks;
+}
+
 void EContext::AddClassFunctionPreCalls(std::string key, void* val)
 {
+    m_classFunctionHooks = true;
+
     if (classFunctionPreCalls.find(key) == classFunctionPreCalls.end())
         classFunctionPreCalls.insert({ key, {} });
 
@@ -240,6 +654,8 @@ std::vector<void*> EContext::GetClassFunctionPreCalls(std::string func_key)
 
 void EContext::AddClassFunctionPostCalls(std::string key, void* val)
 {
+    m_classFunctionHooks = true;
+
     if (classFunctionPostCalls.find(key) == classFunctionPostCalls.end())
         classFunctionPostCalls.insert({ key, {} });
 
@@ -4,6 +4,9 @@
 #include <set>
 #include <map>
 #include <string>
+#include <cstdint>
+#include <functional>
+#include <memory>
 
 #include <lua.hpp>
 #include "dotnet/invoker.h"
@@ -12,15 +15,85 @@
 #include "ContextKinds.h"
 
 class EValue;
+class EAsyncOperation;
+
+#define DOTNET_MEMORY_PRESSURE_STEP (64 * 1024)
+
+enum LuaLibraries
+{
+    LuaLib_Base = 1 << 0,
+    LuaLib_Table = 1 << 1,
+    LuaLib_String = 1 << 2,
+    LuaLib_Math = 1 << 3,
+    LuaLib_Debug = 1 << 4,
+    LuaLib_Coroutine = 1 << 5,
+    LuaLib_UTF8 = 1 << 6,
+    LuaLib_IO = 1 << 7,
+    LuaLib_OS = 1 << 8,
+
+    LuaLib_All = (1 << 9) - 1,
+};
 
 class EContext
 {
 private:
-    void* m_state;
+    void* m_state = nullptr;
+    void* m_activeState = nullptr;
     ContextKinds m_kind;
+    int m_libraries = LuaLib_All;
+    bool m_lazyLibraries = false;
     std::set<EValue*> mappedValues;
+    int m_gcStepSize = 1;
+    bool m_functionHooks = false;
+    bool m_classFunctionHooks = false;
+
+    int64_t m_nativeMemory = 0;
+    int64_t m_reportedMemoryPressure = 0;
+
+    int m_hookCount = 0;
+
+    bool m_profilerRunning = false;
+    int m_profilerPeriod = 0;
+    int m_profilerInstructions = 0;
+    int64_t m_profilerTimePeriod = 0;
+    int64_t m_profilerLastSample = 0;
+    std::map<std::vector<size_t>, uint64_t> m_profilerSamples;
+    std::map<std::string, size_t> m_profilerFrameIds;
+    std::vector<std::string> m_profilerFrameNames;
+
+    int64_t m_budgetInstructions = 0;
+    int64_t m_budgetTime = 0;
+    int m_budgetCheckPeriod = 1000;
+    int64_t m_budgetUsed = 0;
+    int64_t m_budgetStart = 0;
+    int m_scriptCallDepth = 0;
+    bool m_budgetExceeded = false;
+
+    // Coroutines started by RunAsync, with the operation each one is suspended on.
+    struct AsyncThread
+    {
+        int ref;
+        std::shared_ptr<EAsyncOperation> waiting;
+        std::shared_ptr<EAsyncOperation> completion;
+        // Set by PollAsync when the results of `waiting` didn't fit on the coroutine's stack.
+        bool resultsDropped = false;
+    };
+    std::map<lua_State*, AsyncThread> m_asyncThreads;
+    std::vector<std::function<bool()>> m_asyncPollers;
+
+    void ResumeAsync(lua_State* L, int args);
+
+    void UpdateLuaHook();
+    void SampleScriptProfiler(lua_State* L);
+    void CheckScriptBudget(lua_State* L, int count);
+    void RetireDotnetDirect(std::map<std::string, std::unique_ptr<DotnetDirectNative>>& records, const std::string& key);
 
     std::map<std::string, void*> functionCalls;
+    std::map<std::string, void*> functionDotnetThunks;
+    std::map<std::string, std::unique_ptr<DotnetDirectNative>> functionDotnetDirect;
+    std::map<std::string, std::unique_ptr<DotnetDirectNative>> classFunctionDotnetDirect;
+    // Records replaced by a later registration, managed code may still hold them.
+    std::vector<std::unique_ptr<DotnetDirectNative>> retiredDotnetDirect;
 
     std::map<std::string, std::vector<void*>> functionPreCalls;
     std::map<std::string, std::vector<void*>> functionPostCalls;
@@ -40,15 +113,78 @@ private:
     std::map<std::string, std::vector<std::pair<void*, void*>>> classMemberValidPostCalls;
 
 public:
-    EContext(ContextKinds kind);
+    // libraries is a LuaLibraries mask. With lazyLibraries, every library except base and string
+    // is only opened the first time its global is read, through the metatable of _G. Registering into a pending
+    // library's namespace opens it, so does replacing the metatable of _G with setmetatable. Going around it
+    // (debug.setmetatable, lua_setmetatable) leaves the pending libraries unreachable.
+    EContext(ContextKinds kind, int libraries = LuaLib_All, bool lazyLibraries = false);
     ~EContext();
 
+    // Creates a new context with the same libraries and bindings, by copying the registry, the globals and
+    // the metatables of this one instead of running the registrations again. Full userdata values aren't copied.
+    EContext* Clone();
+
     void RegisterLuaLib(const char* libName, lua_CFunction func);
+    void RegisterLazyLuaLib(const char* libName, lua_CFunction func);
 
     ContextKinds GetKind();
     int64_t GetMemoryUsage();
+
+    // Native memory held by the context's class instances (see ClassData::SetNativeSize). On Dotnet contexts
+    // the changes are reported to the .NET GC as memory pressure, once they add up to DOTNET_MEMORY_PRESSURE_STEP.
+    void AddNativeMemory(int64_t delta);
+    int64_t GetNativeMemoryUsage();
+
+    // Runs incremental GC steps until the cycle finishes or budget_us is spent. Returns the time used, in microseconds.
+    int64_t StepGarbageCollector(int64_t budget_us);
+    // Stops the automatic collector so memory is only reclaimed through StepGarbageCollector.
+    void SetManualGarbageCollection(bool state);
+
+    // The Lua thread natives and EValue calls work on: the main state, or the coroutine the current native
+    // was called from (see EActiveStateScope).
     void* GetState();
     lua_State* GetLuaState();
+    lua_State* GetMainLuaState();
+    // Returns the previously active state. nullptr goes back to the main state.
+    void* SetActiveState(void* state);
+
+    // Sampling profiler for Lua code, taking a stack sample every `instruction_period` VM instructions,
+    // or, with `time_period_us`, at most once per period. Costs nothing while it isn't running.
+    void StartScriptProfiler(int instruction_period = 1000, int64_t time_period_us = 0);
+    void StopScriptProfiler();
+    bool IsScriptProfilerRunning();
+    // Samples in the folded stack format ("outer;inner count" per line) used by flamegraph tools.
+    std::string GetScriptProfile();
+    void ResetScriptProfile();
+
+    // Limits how long a single call into Lua (EValue calls, RunFile) can run: at most `max_instructions` VM
+    // instructions and `max_time_us` microseconds, checked every `check_period` instructions. Nested calls share
+    // the budget of the outermost one. Going over raises a Lua error, which reaches the caller as an EException.
+    // 0 disables a limit.
+    void SetScriptBudget(int64_t max_instructions, int64_t max_time_us = 0, int check_period = 1000);
+    void GetScriptBudget(int64_t& max_instructions, int64_t& max_time_us);
+    void GetScriptBudget(int64_t& max_instructions, int64_t& max_time_us, int& check_period);
+
+    void BeginScriptCall();
+    void EndScriptCall();
+
+    // Called by the count hook installed through UpdateLuaHook.
+    void OnLuaHook(lua_State* L, lua_Debug* ar);
+
+    // Copies the hook of the main state (script budget, profiler) to another thread of the context.
+    void SyncLuaHook(lua_State* L);
+
+    // Runs `function` on a coroutine of its own. Natives it calls can suspend it through FunctionContext::Suspend
+    // until their operation completes. The returned operation completes once the function returns or fails.
+    std::shared_ptr<EAsyncOperation> RunAsync(EValue& function);
+    // Runs the async pollers, then resumes every coroutine whose operation has completed. Has to be called
+    // regularly (e.g. every tick) from the thread owning the context. Returns how many coroutines are still suspended.
+    int PollAsync();
+    // `poller` is called on every PollAsync until it returns true.
+    void AddAsyncPoller(std::function<bool()> poller);
+    bool IsAsyncThread(lua_State* L);
+    void SuspendAsync(lua_State* L, std::shared_ptr<EAsyncOperation> op);
+    bool AsyncResultsDropped(lua_State* L);
 
     int RunFile(std::string path);
 
@@ -58,6 +194,18 @@ public:
     void AddFunctionCall(std::string key, void* val);
     void* GetFunctionCall(std::string key);
 
+    void AddFunctionDotnetThunk(std::string key, void* val);
+    void* GetFunctionDotnetThunk(std::string key);
+
+    void AddFunctionDotnetDirect(std::string namespace_path, std::string function_name, void* entry);
+    DotnetDirectNative* GetFunctionDotnetDirect(std::string key);
+
+    void AddClassFunctionDotnetDirect(std::string class_name, std::string function_name, void* entry);
+    DotnetDirectNative* GetClassFunctionDotnetDirect(std::string key);
+
+    // Whether any function pre/post hook or FunctionContext (un)register callback exists in this context.
+    bool HasFunctionHooks();
+
     void AddFunctionPreCall(std::string key, void* val);
     std::vector<void*> GetFunctionPreCalls(std::string function_key);
 
@@ -67,6 +215,9 @@ public:
     void AddClassFunctionCalls(std::string key, void* val);
     void* GetClassFunctionCall(std::string key);
 
+    // Whether any class function pre/post hook exists in this context.
+    bool HasClassFunctionHooks();
+
     void AddClassFunctionPreCalls(std::string key, void* val);
     std::vector<void*> GetClassFunctionPreCalls(std::string function_key);
 
@@ -87,4 +238,59 @@ public:
 
 EContext* GetContextByState(lua_State* ctx);
 
+// Opens the library `name` if it's still pending in a context with lazy libraries, and pushes it.
+// Returns false, pushing nothing, when there's no such pending library.
+bool OpenLazyLuaLib(lua_State* L, const char* name);
+
+// Makes `L`, a thread of the context, the one Stack<T>, FunctionContext and EValue work on while it's alive.
+class EActiveStateScope
+{
+private:
+    EContext* m_ctx;
+    void* m_prev;
+
+public:
+    EActiveStateScope(EContext* ctx, lua_State* L) : m_ctx(ctx) { m_prev = m_ctx->SetActiveState(L); }
+    ~EActiveStateScope() { m_ctx->SetActiveState(m_prev); }
+
+    EActiveStateScope(const EActiveStateScope&) = delete;
+    EActiveStateScope& operator=(const EActiveStateScope&) = delete;
+};
+
+// Tracks a call into Lua, so the script budget restarts for every outermost call.
+class EScriptCallScope
+{
+private:
+    EContext* m_ctx;
+
+public:
+    EScriptCallScope(EContext* ctx) : m_ctx(ctx) { m_ctx->BeginScriptCall(); }
+    ~EScriptCallScope() { m_ctx->EndScriptCall(); }
+
+    EScriptCallScope(const EScriptCallScope&) = delete;
+    EScriptCallScope& operator=(const EScriptCallScope&) = delete;
+};
+
+// Overrides the context's script budget for the calls made while it's alive, keeping its check period.
+class EScriptBudgetScope
+{
+private:
+    EContext* m_ctx;
+    int64_t m_prevInstructions;
+    int64_t m_prevTime;
+    int m_prevPeriod;
+
+public:
+    EScriptBudgetScope(EContext* ctx, int64_t max_instructions, int64_t max_time_us = 0) : m_ctx(ctx)
+    {
+        m_ctx->GetScriptBudget(m_prevInstructions, m_prevTime, m_prevPeriod);
+        m_ctx->SetScriptBudget(max_instructions, max_time_us, m_prevPeriod);
+    }
+
+    ~EScriptBudgetScope() { m_ctx->SetScriptBudget(m_prevInstructions, m_prevTime, m_prevPeriod); }
+
+    EScriptBudgetScope(const EScriptBudgetScope&) = delete;
+    EScriptBudgetScope& operator=(const EScriptBudgetScope&) = delete;
+};
+
 #endif
\ No newline at end of file
@@ -0,0 +1,340 @@
+#include "Context.h"
+#include "Helpers.h"
+
+#include <string>
+#include <vector>
+
+static int CloneWriter(lua_State* L, const void* p, size_t sz, void* ud)
+{
+    if (p && sz > 0)
+        ((std::string*)ud)->append((const char*)p, sz);
+    return 0;
+}
+
+static bool CloneCached(lua_State* from, int idx, lua_State* to, int cache)
+{
+    lua_rawgetp(to, cache, lua_topointer(from, idx));
+    if (!lua_isnil(to, -1))
+        return true;
+
+    lua_pop(to, 1);
+    return false;
+}
+
+static void CloneStore(lua_State* from, int idx, lua_State* to, int cache)
+{
+    lua_pushvalue(to, -1);
+    lua_rawsetp(to, cache, lua_topointer(from, idx));
+}
+
+// Upvalues are cached by their id, as the copied closure and index holding them, so closures that share an
+// upvalue in `from` share it in `to` too.
+static bool JoinCachedUpvalue(lua_State* from, int idx, int n, lua_State* to, int closure, int cache)
+{
+    if (lua_rawgetp(to, cache, lua_upvalueid(from, idx, n)) != LUA_TTABLE) // entry | nil
+    {
+        lua_pop(to, 1);
+        return false;
+    }
+
+    lua_rawgeti(to, -1, 1); // entry, owner
+    lua_rawgeti(to, -2, 2); // entry, owner, index
+    lua_upvaluejoin(to, closure, n, lua_absindex(to, -2), (int)lua_tointeger(to, -1));
+    lua_pop(to, 3);
+    return true;
+}
+
+static void StoreUpvalue(lua_State* from, int idx, int n, lua_State* to, int closure, int cache)
+{
+    lua_createtable(to, 2, 0);
+    lua_pushvalue(to, closure);
+    lua_rawseti(to, -2, 1);
+    lua_pushinteger(to, n);
+    lua_rawseti(to, -2, 2);
+    lua_rawsetp(to, cache, lua_upvalueid(from, idx, n));
+}
+
+// Copies the value at `idx` of `from` on top of `to`.
+// `cache` maps already copied tables and Lua functions (by their address in `from`) to their copy in `to`,
+// so shared references and cycles are preserved. Full userdata and threads can't be copied and become nil.
+static void CloneValue(lua_State* from, int idx, lua_State* to, int cache)
+{
+    idx = lua_absindex(from, idx);
+    luaL_checkstack(from, 4, "clone: source stack overflow");
+    luaL_checkstack(to, 4, "clone: target stack overflow");
+
+    switch (lua_type(from, idx))
+    {
+    case LUA_TBOOLEAN:
+        lua_pushboolean(to, lua_toboolean(from, idx));
+        break;
+    case LUA_TNUMBER:
+        if (lua_isinteger(from, idx))
+            lua_pushinteger(to, lua_tointeger(from, idx));
+        else
+            lua_pushnumber(to, lua_tonumber(from, idx));
+        break;
+    case LUA_TSTRING:
+    {
+        size_t len;
+        const char* str = lua_tolstring(from, idx, &len);
+        lua_pushlstring(to, str, len);
+        break;
+    }
+    case LUA_TLIGHTUSERDATA:
+        lua_pushlightuserdata(to, lua_touserdata(from, idx));
+        break;
+    case LUA_TTABLE:
+    {
+        if (CloneCached(from, idx, to, cache))
+            break;
+
+        lua_createtable(to, (int)lua_rawlen(from, idx), 0); // t
+        CloneStore(from, idx, to, cache);
+
+        lua_pushnil(from);
+        while (lua_next(from, idx) != 0) // from: key, value
+        {
+            CloneValue(from, -2, to, cache); // t, key
+            CloneValue(from, -1, to, cache); // t, key, value
+            if (lua_isnil(to, -2) || lua_isnil(to, -1))
+                lua_pop(to, 2); // t
+            else
+                lua_rawset(to, -3); // t
+
+            lua_pop(from, 1); // from: key
+        }
+
+        if (lua_getmetatable(from, idx)) // from: mt
+        {
+            CloneValue(from, -1, to, cache); // t, mt
+            if (lua_istable(to, -1))
+                lua_setmetatable(to, -2); // t
+            else
+                lua_pop(to, 1); // t
+            lua_pop(from, 1);
+        }
+        break;
+    }
+    case LUA_TFUNCTION:
+    {
+        // C closures are cheap and only hold plain values, they're copied without going through the cache.
+        if (lua_iscfunction(from, idx))
+        {
+            lua_CFunction func = lua_tocfunction(from, idx);
+            int n = 0;
+            while (lua_getupvalue(from, idx, n + 1))
+            {
+                CloneValue(from, -1, to, cache);
+                lua_pop(from, 1);
+                n++;
+            }
+            lua_pushcclosure(to, func, n);
+        }
+        else
+        {
+            if (CloneCached(from, idx, to, cache))
+                break;
+
+            std::string code;
+            lua_pushvalue(from, idx);
+            lua_dump(from, CloneWriter, &code, 0);
+            lua_pop(from, 1);
+
+            if (luaL_loadbufferx(to, code.data(), code.size(), "=clone", "b") != LUA_OK)
+            {
+                lua_pop(to, 1);
+                lua_pushnil(to);
+                break;
+            }
+            CloneStore(from, idx, to, cache);
+
+            int closure = lua_gettop(to);
+            for (int i = 1; lua_getupvalue(from, idx, i); i++)
+            {
+                if (!JoinCachedUpvalue(from, idx, i, to, closure, cache))
+                {
+                    CloneValue(from, -1, to, cache);
+
+                    // Copying the value can reach another closure sharing this upvalue, which stored it first.
+                    if (JoinCachedUpvalue(from, idx, i, to, closure, cache))
+                        lua_pop(to, 1);
+                    else if (lua_setupvalue(to, closure, i))
+                        StoreUpvalue(from, idx, i, to, closure, cache);
+                    else
+                        lua_pop(to, 1);
+                }
+                lua_pop(from, 1);
+            }
+        }
+        break;
+    }
+    default:
+        lua_pushnil(to);
+        break;
+    }
+}
+
+// Copies every entry of the table at `src` which doesn't exist yet in the table at `dst`.
+static void CloneMissingEntries(lua_State* from, int src, lua_State* to, int dst, int cache, bool skipIntegerKeys)
+{
+    src = lua_absindex(from, src);
+    dst = lua_absindex(to, dst);
+
+    lua_pushnil(from);
+    while (lua_next(from, src) != 0) // from: key, value
+    {
+        if (skipIntegerKeys && lua_isinteger(from, -2))
+        {
+            lua_pop(from, 1);
+            continue;
+        }
+
+        CloneValue(from, -2, to, cache); // key
+        lua_pushvalue(to, -1);           // key, key
+        if (lua_isnil(to, -1) || lua_rawget(to, dst) != LUA_TNIL) // key, existing | nil
+        {
+            lua_pop(to, 2);
+            lua_pop(from, 1);
+            continue;
+        }
+        lua_pop(to, 1); // key
+
+        CloneValue(from, -1, to, cache); // key, value
+        if (lua_isnil(to, -1))
+            lua_pop(to, 2);
+        else
+            lua_rawset(to, dst);
+
+        lua_pop(from, 1); // from: key
+    }
+}
+
+// Puts both stacks back and restarts the clone's collector, also when a Lua error (thrown by the panic
+// handler) interrupts the copy.
+struct CloneGuard
+{
+    lua_State* from;
+    lua_State* to;
+    int fromTop;
+    int toTop;
+
+    CloneGuard(lua_State* f, lua_State* t) : from(f), to(t), fromTop(lua_gettop(f)), toTop(lua_gettop(t))
+    {
+        // Everything created here stays alive, running the collector while copying would only traverse it over and over.
+        lua_gc(to, LUA_GCSTOP);
+    }
+
+    ~CloneGuard()
+    {
+        lua_settop(from, fromTop);
+        lua_settop(to, toTop);
+        lua_gc(to, LUA_GCRESTART);
+    }
+};
+
+static void CloneGlobals(lua_State* from, lua_State* to)
+{
+    lua_newtable(to); // cache
+    int cache = lua_gettop(to);
+
+    lua_pushglobaltable(from);
+    int fromGlobals = lua_gettop(from);
+    lua_pushglobaltable(to);
+    int toGlobals = lua_gettop(to);
+
+    // The tables and functions both states already have (_G, the registry, stdlib tables)
+    // map to their counterparts, so the copies reference the new context's versions.
+    // lua_getfield goes through the lazy library stub, so libraries the template opened get opened here too.
+    lua_pushvalue(to, toGlobals);
+    lua_rawsetp(to, cache, lua_topointer(from, fromGlobals));
+    lua_pushvalue(to, LUA_REGISTRYINDEX);
+    lua_rawsetp(to, cache, lua_topointer(from, LUA_REGISTRYINDEX));
+
+    std::vector<std::string> sharedTables;
+    lua_pushnil(from);
+    while (lua_next(from, fromGlobals) != 0)
+    {
+        if (lua_type(from, -2) == LUA_TSTRING && (lua_istable(from, -1) || lua_isfunction(from, -1)))
+        {
+            if (lua_getfield(to, toGlobals, lua_tostring(from, -2)) != LUA_TNIL)
+            {
+                if (lua_istable(to, -1) && !lua_rawequal(to, -1, toGlobals))
+                    sharedTables.push_back(lua_tostring(from, -2));
+                lua_rawsetp(to, cache, lua_topointer(from, -1));
+            }
+            else
+                lua_pop(to, 1);
+        }
+        lua_pop(from, 1);
+    }
+
+    // Registry first, so class metatables created by luaL_newmetatable are in place before the globals using them.
+    // Integer keys are references owned by EValues of the template and aren't copied.
+    CloneMissingEntries(from, LUA_REGISTRYINDEX, to, LUA_REGISTRYINDEX, cache, true);
+    CloneMissingEntries(from, fromGlobals, to, toGlobals, cache, false);
+
+    // What was added to the tables both states have, like natives registered into a stdlib namespace ("string").
+    for (auto& name : sharedTables)
+    {
+        lua_pushstring(from, name.c_str());
+        lua_rawget(from, fromGlobals);
+        lua_pushstring(to, name.c_str());
+        lua_rawget(to, toGlobals);
+        if (lua_istable(from, -1) && lua_istable(to, -1))
+            CloneMissingEntries(from, -1, to, -1, cache, false);
+        lua_pop(from, 1);
+        lua_pop(to, 1);
+    }
+}
+
+EContext* EContext::Clone()
+{
+    EContext* ctx = new EContext(m_kind, m_libraries, m_lazyLibraries);
+
+    ctx->m_functionHooks = m_functionHooks;
+    ctx->m_classFunctionHooks = m_classFunctionHooks;
+    ctx->functionCalls = functionCalls;
+    ctx->functionDotnetThunks = functionDotnetThunks;
+    ctx->functionPreCalls = functionPreCalls;
+    ctx->functionPostCalls = functionPostCalls;
+    ctx->functionValidPreCalls = functionValidPreCalls;
+    ctx->functionValidPostCalls = functionValidPostCalls;
+
+    ctx->classFunctionCalls = classFunctionCalls;
+    ctx->classFunctionPreCalls = classFunctionPreCalls;
+    ctx->classFunctionPostCalls = classFunctionPostCalls;
+    ctx->classFunctionValidPreCalls = classFunctionValidPreCalls;
+    ctx->classFunctionValidPostCalls = classFunctionValidPostCalls;
+
+    ctx->classMemberCalls = classMemberCalls;
+    ctx->classMemberPreCalls = classMemberPreCalls;
+    ctx->classMemberPostCalls = classMemberPostCalls;
+    ctx->classMemberValidPreCalls = classMemberValidPreCalls;
+    ctx->classMemberValidPostCalls = classMemberValidPostCalls;
+
+    // Direct records point back at their context, the clone gets records of its own.
+    for (auto& [key, native] : functionDotnetDirect)
+        ctx->AddFunctionDotnetDirect(native->namespace_path, native->function_name, native->entry);
+    for (auto& [key, native] : classFunctionDotnetDirect)
+        ctx->AddClassFunctionDotnetDirect(native->namespace_path, native->function_name, native->entry);
+
+    if (m_kind != ContextKinds::Lua)
+        return ctx;
+
+    lua_State* from = (lua_State*)m_state;
+    lua_State* to = (lua_State*)ctx->m_state;
+
+    try
+    {
+        CloneGuard guard(from, to);
+        CloneGlobals(from, to);
+    }
+    catch (...)
+    {
+        delete ctx;
+        throw;
+    }
+
+    return ctx;
+}
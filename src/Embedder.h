@@ -3,6 +3,8 @@
 
 #include "Context.h"
 #include "Value.h"
+#include "PreparedCall.h"
+#include "Async.h"
 #include "Engine.h"
 
 #endif
\ No newline at end of file
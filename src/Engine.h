@@ -63,11 +63,25 @@ void AddScriptingVariables(EContext* ctx, std::string namespace_path, std::map<s
     AddScriptingFunctionPost(ctx, ns_path, function_name, callback)
 
 typedef void (*ScriptingFunctionCallback)(FunctionContext*);
+typedef void (*DotnetFunctionThunk)(EContext*, CallContext&);
 
 void AddScriptingFunction(EContext* ctx, std::string namespace_path, std::string function_name, ScriptingFunctionCallback callback);
+void AddScriptingFunction(EContext* ctx, std::string namespace_path, std::string function_name, ScriptingFunctionCallback callback, lua_CFunction lua_callback);
 void AddScriptingFunctionPre(EContext* ctx, std::string namespace_path, std::string function_name, ScriptingFunctionCallback callback);
 void AddScriptingFunctionPost(EContext* ctx, std::string namespace_path, std::string function_name, ScriptingFunctionCallback callback);
 
+//////////////////////////////////////////////////////////////
+/////////////////  Scripting Engine Namespaces  /////////////
+////////////////////////////////////////////////////////////
+
+#define ADD_NAMESPACE(ns_path, ...) \
+    AddScriptingNamespace(ctx, ns_path, __VA_ARGS__)
+#define ADD_NAMESPACE_CTX(ctx, ns_path, ...) \
+    AddScriptingNamespace(ctx, ns_path, __VA_ARGS__)
+
+// Registers a whole namespace at once, resolving (and presizing) its table only one time.
+void AddScriptingNamespace(EContext* ctx, const std::string& namespace_path, const std::map<std::string, ScriptingFunctionCallback>& functions, const std::map<std::string, EValue>& variables = {});
+
 //////////////////////////////////////////////////////////////
 /////////////////  Scripting Class Functions   //////////////
 ////////////////////////////////////////////////////////////
@@ -133,4 +147,6 @@ void AddScriptingClassMember(EContext* ctx, std::string class_name, std::string
 void AddScriptingClassMemberPre(EContext* ctx, std::string class_name, std::string member_name, ScriptingClassFunctionCallback callback_get, ScriptingClassFunctionCallback callback_set);
 void AddScriptingClassMemberPost(EContext* ctx, std::string class_name, std::string member_name, ScriptingClassFunctionCallback callback_get, ScriptingClassFunctionCallback callback_set);
 
+#include "engine/bind.h"
+
 #endif
\ No newline at end of file
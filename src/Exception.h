@@ -2,17 +2,34 @@
 #define _embedding_internal_exception_h
 
 #include <exception>
+#include <memory>
 #include <string>
+#include <vector>
 
 #include <lua.hpp>
 
 #include "ContextKinds.h"
 #include "Context.h"
+#include "Helpers.h"
+
+// One level of the Lua stack at the point an error was raised.
+struct EStackFrame
+{
+    std::string source;
+    int currentline;
+    int linedefined;
+    std::string name;
+    std::string namewhat;
+    char what;
+};
 
 class EException : public std::exception
 {
 private:
-    std::string m_what;
+    std::string m_message;
+    mutable std::string m_what;
+    mutable bool m_formatted = false;
+    std::shared_ptr<std::vector<EStackFrame>> m_frames;
     ContextKinds m_kind;
     void* m_ctx;
     char* toDeallocate = nullptr;
@@ -20,9 +37,22 @@ private:
 public:
     EException(void* ctx, ContextKinds kind, int /*code*/) { m_kind = kind; m_ctx = ctx; whatFromStack(); }
     EException(void* ctx, ContextKinds kind, char const*, char const*, long) { m_kind = kind; m_ctx = ctx; whatFromStack(); }
+    EException(void* ctx, ContextKinds kind, std::string message) : m_message(std::move(message)) { m_kind = kind; m_ctx = ctx; }
     ~EException() throw() {}
 
-    const char* what() const throw() { return m_what.c_str(); }
+    // The traceback is only formatted the first time it's asked for.
+    const char* what() const throw()
+    {
+        if (!m_formatted) {
+            m_what = m_message;
+            if (m_frames && !m_frames->empty()) m_what += formatTraceback(*m_frames);
+            m_formatted = true;
+        }
+        return m_what.c_str();
+    }
+
+    const std::string& message() const { return m_message; }
+    const std::vector<EStackFrame>* frames() const { return m_frames.get(); }
 
     template<class Exception>
     static void Throw(Exception e)
@@ -33,72 +63,110 @@ public:
     static void Enable(void* ctx, ContextKinds kind) {
         if (kind == ContextKinds::Lua) {
             lua_atpanic((lua_State*)ctx, thrower);
+
+            lua_pushcfunction((lua_State*)ctx, messageHandler);
+            lua_rawsetp((lua_State*)ctx, LUA_REGISTRYINDEX, getMessageHandlerKey());
         }
     }
 
     static void pcall(EContext* ctx, int args, int results)
     {
         if (ctx->GetKind() == ContextKinds::Lua) {
+            EScriptCallScope call(ctx);
             int code = lua_pcall((lua_State*)ctx->GetState(), args, results, 0);
             if (code != LUA_OK) Throw(EException(ctx->GetState(), ctx->GetKind(), code));
         }
     }
 
+    // Calls the function below the `args` arguments on top of the stack, with the context's message handler
+    // placed right under it.
     static void xpcall(EContext* ctx, int args, int results)
     {
         if (ctx->GetKind() == ContextKinds::Lua) {
-            lua_pushcfunction((lua_State*)ctx->GetState(), traceback);
-            lua_insert((lua_State*)ctx->GetState(), 1);
-            int code = lua_pcall((lua_State*)ctx->GetState(), args, results, 1);
-            lua_remove((lua_State*)ctx->GetState(), 1);
-            if (code != LUA_OK) Throw(EException(ctx->GetState(), ctx->GetKind(), code));
+            lua_State* L = (lua_State*)ctx->GetState();
+            EScriptCallScope call(ctx);
+
+            int base = lua_gettop(L) - args;
+            lua_rawgetp(L, LUA_REGISTRYINDEX, getMessageHandlerKey());
+            lua_insert(L, base);
+
+            int code = lua_pcall(L, args, results, base);
+            if (code != LUA_OK) {
+                EException e(L, ctx->GetKind(), code);
+                lua_remove(L, base);
+                Throw(e);
+            }
+            lua_remove(L, base);
         }
     }
 
 protected:
     void whatFromStack() {
+        m_formatted = false;
         if (m_kind == ContextKinds::Lua) {
             if (lua_gettop((lua_State*)m_ctx) > 0) {
-                std::string errorMessage;
                 const char* errorPtr = lua_tostring((lua_State*)m_ctx, -1);
-                errorMessage = errorPtr ? errorPtr : "Empty error.";
+                m_message = errorPtr ? errorPtr : "Empty error.";
                 lua_pop((lua_State*)m_ctx, 1);
-
-                lua_pushcfunction((lua_State*)m_ctx, traceback);
-                lua_pushvalue((lua_State*)m_ctx, -2);
-                lua_pushinteger((lua_State*)m_ctx, 2);
-                lua_call((lua_State*)m_ctx, 2, 1);
-
-                const char* tracebackPtr = lua_tostring((lua_State*)m_ctx, -1);
-                std::string tracebackString = tracebackPtr ? tracebackPtr : "No traceback available.";
-                lua_pop((lua_State*)m_ctx, 1);
-
-                m_what = errorMessage;
             }
             else {
-                m_what = "Empty error.";
+                m_message = "Empty error.";
+            }
+
+            std::vector<EStackFrame>& captured = capturedFrames();
+            if (!captured.empty()) {
+                m_frames = std::make_shared<std::vector<EStackFrame>>();
+                m_frames->swap(captured);
             }
         }
     }
 
 private:
+    enum { MaxFrames = 32 };
+
+    static std::vector<EStackFrame>& capturedFrames()
+    {
+        static thread_local std::vector<EStackFrame> frames;
+        return frames;
+    }
+
     static int thrower(lua_State* L) { throw EException((void*)L, ContextKinds::Lua, -1); }
-    static int traceback(lua_State* L) {
-        lua_getglobal(L, "debug");
-        if (!lua_istable(L, -1)) {
-            lua_pop(L, 1);
-            return 1;
-        }
-        lua_getfield(L, -1, "traceback");
-        if (!lua_isfunction(L, -1)) {
-            lua_pop(L, 2);
-            return 1;
+
+    // Copies the raw frame data and leaves the error object untouched, the text is built by what().
+    static int messageHandler(lua_State* L) {
+        std::vector<EStackFrame>& captured = capturedFrames();
+        captured.clear();
+
+        lua_Debug ar;
+        for (int level = 1; level <= MaxFrames && lua_getstack(L, level, &ar); level++) {
+            lua_getinfo(L, "Sln", &ar);
+            captured.push_back({ ar.short_src, ar.currentline, ar.linedefined, ar.name ? ar.name : "", ar.namewhat ? ar.namewhat : "", ar.what ? *ar.what : '?' });
         }
-        lua_pushvalue(L, 1);
-        lua_pushinteger(L, 2);
-        lua_call(L, 2, 1);
+
+        lua_settop(L, 1);
         return 1;
     }
+
+    // Same layout as luaL_traceback.
+    static std::string formatTraceback(const std::vector<EStackFrame>& frames) {
+        std::string out = "\nstack traceback:";
+        for (auto& frame : frames) {
+            out += "\n\t";
+            if (frame.what == 'C') out += "[C]:";
+            else {
+                out += frame.source + ":";
+                if (frame.currentline > 0) out += std::to_string(frame.currentline) + ":";
+            }
+
+            out += " in ";
+            if (frame.namewhat == "global") out += "function '" + frame.name + "'";
+            else if (!frame.namewhat.empty()) out += frame.namewhat + " '" + frame.name + "'";
+            else if (frame.what == 'm') out += "main chunk";
+            else if (frame.what == 'C') out += "?";
+            else out += "function <" + frame.source + ":" + std::to_string(frame.linedefined) + ">";
+        }
+        return out;
+    }
 };
 
 #endif
\ No newline at end of file
@@ -1,9 +1,18 @@
 #include "GarbageCollector.h"
+#include "Context.h"
+#include "engine/classes.h"
 
 #include <set>
+#include <vector>
+#include <algorithm>
+#include <chrono>
 
 std::set<void*> deleteOnGC;
 
+std::vector<EContext*> gcContexts;
+size_t gcCursor = 0;
+double gcBudgetUsage = 0.0;
+
 void MarkDeleteOnGC(void* ptr)
 {
     deleteOnGC.insert(ptr);
@@ -20,4 +29,60 @@ bool CheckAndPopDeleteOnGC(void* ptr)
 bool ShouldDeleteOnGC(void* ptr)
 {
     return deleteOnGC.find(ptr) != deleteOnGC.end();
-}
\ No newline at end of file
+}
+
+void DetachDeleteOnGC(EContext* ctx)
+{
+    for (void* ptr : deleteOnGC)
+    {
+        ClassData* data = (ClassData*)ptr;
+        if (data->GetContext() == ctx) data->DetachContext();
+    }
+}
+
+void RegisterGCContext(EContext* ctx)
+{
+    if (std::find(gcContexts.begin(), gcContexts.end(), ctx) != gcContexts.end()) return;
+    gcContexts.push_back(ctx);
+}
+
+void UnregisterGCContext(EContext* ctx)
+{
+    auto it = std::find(gcContexts.begin(), gcContexts.end(), ctx);
+    if (it == gcContexts.end()) return;
+
+    gcContexts.erase(it);
+    if (gcCursor >= gcContexts.size()) gcCursor = 0;
+}
+
+int64_t StepGarbageCollectors(int64_t budget_us)
+{
+    if (gcContexts.empty() || budget_us <= 0) {
+        gcBudgetUsage = 0.0;
+        return 0;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    size_t count = gcContexts.size();
+    int64_t used = 0;
+
+    // Every context gets an equal share of what is left, so time not used by one rolls over to the next ones.
+    // The starting context rotates every tick so the last ones in the list don't starve.
+    for (size_t i = 0; i < count && used < budget_us; i++) {
+        EContext* ctx = gcContexts[(gcCursor + i) % count];
+        int64_t slice = (budget_us - used) / (int64_t)(count - i);
+        if (slice <= 0) slice = budget_us - used;
+
+        ctx->StepGarbageCollector(slice);
+        used = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    gcCursor = (gcCursor + 1) % count;
+    gcBudgetUsage = (double)used / (double)budget_us;
+    return used;
+}
+
+double GetGarbageCollectorBudgetUsage()
+{
+    return gcBudgetUsage;
+}
@@ -1,8 +1,23 @@
 #ifndef _embedder_internal_gc_h
 #define _embedder_internal_gc_h
 
+#include <cstdint>
+
+class EContext;
+
 void MarkDeleteOnGC(void* ptr);
 bool CheckAndPopDeleteOnGC(void* ptr);
 bool ShouldDeleteOnGC(void* ptr);
+// Detaches the delete-on-GC class instances still referencing `ctx`, which is being destroyed.
+void DetachDeleteOnGC(EContext* ctx);
+
+void RegisterGCContext(EContext* ctx);
+void UnregisterGCContext(EContext* ctx);
+
+// Spreads incremental GC steps over all Lua contexts, meant to run in the idle time at the end of a server tick.
+// Returns the time used, in microseconds.
+int64_t StepGarbageCollectors(int64_t budget_us);
+// Fraction of the last StepGarbageCollectors budget that was used (0.0 - 1.0+).
+double GetGarbageCollectorBudgetUsage();
 
-#endif
\ No newline at end of file
+#endif
@@ -73,6 +73,26 @@ inline const void* getContextKey()
 #endif
 }
 
+inline const void* getLazyLibsKey()
+{
+#ifdef _NDEBUG
+    static char value;
+    return &value;
+#else
+    return reinterpret_cast<void*>(0x11b);
+#endif
+}
+
+inline const void* getMessageHandlerKey()
+{
+#ifdef _NDEBUG
+    static char value;
+    return &value;
+#else
+    return reinterpret_cast<void*>(0xe44);
+#endif
+}
+
 inline std::vector<std::string> str_split(std::string s, std::string delimiter)
 {
     if (s.size() == 0) return {};
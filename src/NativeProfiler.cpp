@@ -0,0 +1,391 @@
+#include "NativeProfiler.h"
+
+#include <chrono>
+#include <cstdio>
+#include <map>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+std::atomic<bool> nativeProfilerEnabled{ false };
+
+// Bumped by ResetNativeProfiler, each thread zeroes its own counters once it sees a newer generation.
+std::atomic<uint64_t> profilerResetGeneration{ 0 };
+
+//////////////////////////////////////////////////////////////
+/////////////////         Histograms           //////////////
+////////////////////////////////////////////////////////////
+
+// Log-linear buckets: exact below 16ns, then 8 sub-buckets per power of two (~12.5% precision) up to 2^44ns.
+#define PROFILER_LINEAR_BUCKETS 16
+#define PROFILER_SUB_BUCKETS 8
+#define PROFILER_MAX_EXPONENT 44
+#define PROFILER_BUCKETS (PROFILER_LINEAR_BUCKETS + (PROFILER_MAX_EXPONENT - 4 + 1) * PROFILER_SUB_BUCKETS)
+
+static int HighestBit(uint64_t value)
+{
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanReverse64(&index, value);
+    return (int)index;
+#else
+    return 63 - __builtin_clzll(value);
+#endif
+}
+
+static int BucketIndex(uint64_t value)
+{
+    if (value < PROFILER_LINEAR_BUCKETS) return (int)value;
+
+    int exponent = HighestBit(value);
+    if (exponent > PROFILER_MAX_EXPONENT) return PROFILER_BUCKETS - 1;
+
+    int sub = (int)((value >> (exponent - 3)) & (PROFILER_SUB_BUCKETS - 1));
+    return PROFILER_LINEAR_BUCKETS + (exponent - 4) * PROFILER_SUB_BUCKETS + sub;
+}
+
+static uint64_t BucketUpperBound(int index)
+{
+    if (index < PROFILER_LINEAR_BUCKETS) return (uint64_t)index;
+
+    int exponent = 4 + (index - PROFILER_LINEAR_BUCKETS) / PROFILER_SUB_BUCKETS;
+    int sub = (index - PROFILER_LINEAR_BUCKETS) % PROFILER_SUB_BUCKETS;
+    return ((uint64_t)(PROFILER_SUB_BUCKETS + sub + 1) << (exponent - 3)) - 1;
+}
+
+// Only the owning thread writes (resets included), so plain load/store pairs are enough and no locked instruction is needed.
+static inline void RelaxedAdd(std::atomic<uint64_t>& counter, uint64_t value)
+{
+    counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+}
+
+struct NativeProfilerHistogram
+{
+    std::atomic<uint64_t> buckets[PROFILER_BUCKETS];
+    std::atomic<uint64_t> total;
+    std::atomic<uint64_t> max;
+
+    NativeProfilerHistogram()
+    {
+        Reset();
+    }
+
+    void Record(int64_t value)
+    {
+        uint64_t v = value < 0 ? 0 : (uint64_t)value;
+        RelaxedAdd(buckets[BucketIndex(v)], 1);
+        RelaxedAdd(total, v);
+        if (v > max.load(std::memory_order_relaxed)) max.store(v, std::memory_order_relaxed);
+    }
+
+    void Reset()
+    {
+        for (auto& bucket : buckets) bucket.store(0, std::memory_order_relaxed);
+        total.store(0, std::memory_order_relaxed);
+        max.store(0, std::memory_order_relaxed);
+    }
+};
+
+struct NativeProfilerEntry
+{
+    std::atomic<uint64_t> calls{ 0 };
+    NativeProfilerHistogram inclusive;
+    NativeProfilerHistogram exclusive;
+    NativeProfilerHistogram hooks;
+};
+
+struct NativeProfilerThread
+{
+    // Only taken to add a key, or by a snapshot reading this thread's keys.
+    std::mutex mutex;
+    std::unordered_map<std::string, NativeProfilerEntry*> entries[(int)NativeProfilerKind::Count];
+    // Reset generation the counters belong to, snapshots skip threads which haven't applied the latest reset yet.
+    std::atomic<uint64_t> generation{ 0 };
+
+    void ApplyReset(uint64_t latest)
+    {
+        for (auto& kindEntries : entries)
+        {
+            for (auto& entry : kindEntries)
+            {
+                entry.second->calls.store(0, std::memory_order_relaxed);
+                entry.second->inclusive.Reset();
+                entry.second->exclusive.Reset();
+                entry.second->hooks.Reset();
+            }
+        }
+        generation.store(latest, std::memory_order_release);
+    }
+};
+
+std::mutex profilerThreadsMutex;
+std::vector<NativeProfilerThread*> profilerThreads;
+
+thread_local NativeProfilerThread* profilerThread = nullptr;
+thread_local NativeProfilerScope* profilerCurrentScope = nullptr;
+
+static NativeProfilerEntry* GetProfilerEntry(NativeProfilerKind kind, const std::string& key)
+{
+    uint64_t latest = profilerResetGeneration.load(std::memory_order_acquire);
+    if (!profilerThread) {
+        profilerThread = new NativeProfilerThread();
+        profilerThread->generation.store(latest, std::memory_order_relaxed);
+
+        std::lock_guard<std::mutex> lock(profilerThreadsMutex);
+        profilerThreads.push_back(profilerThread);
+    }
+    else if (profilerThread->generation.load(std::memory_order_relaxed) != latest) profilerThread->ApplyReset(latest);
+
+    auto& entries = profilerThread->entries[(int)kind];
+    auto it = entries.find(key);
+    if (it != entries.end()) return it->second;
+
+    NativeProfilerEntry* entry = new NativeProfilerEntry();
+
+    std::lock_guard<std::mutex> lock(profilerThread->mutex);
+    entries.insert({ key, entry });
+    return entry;
+}
+
+int64_t NativeProfilerNow()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+//////////////////////////////////////////////////////////////
+/////////////////           Scopes             //////////////
+////////////////////////////////////////////////////////////
+
+void NativeProfilerScope::Begin(NativeProfilerKind kind, const std::string& key)
+{
+    m_entry = GetProfilerEntry(kind, key);
+    m_parent = profilerCurrentScope;
+    profilerCurrentScope = this;
+    m_start = NativeProfilerNow();
+}
+
+void NativeProfilerScope::End()
+{
+    int64_t now = NativeProfilerNow();
+    int64_t inclusive = now - m_start;
+
+    // A hook which raised an error never reached HooksEnd.
+    if (m_hooksStart != 0) m_hooksTime += now - m_hooksStart;
+
+    RelaxedAdd(m_entry->calls, 1);
+    m_entry->inclusive.Record(inclusive);
+    m_entry->exclusive.Record(inclusive - m_hooksTime - m_childTime);
+    m_entry->hooks.Record(m_hooksTime);
+
+    // Natives called from a hook are already part of the parent's hook time.
+    if (m_parent && !m_parent->InHooks()) m_parent->m_childTime += inclusive;
+
+    profilerCurrentScope = m_parent;
+}
+
+void EnableNativeProfiler(bool state)
+{
+    nativeProfilerEnabled.store(state, std::memory_order_relaxed);
+}
+
+void ResetNativeProfiler()
+{
+    // Storing zeroes from here would race with the owners' load/store increments, so only the owners reset.
+    profilerResetGeneration.fetch_add(1, std::memory_order_release);
+}
+
+//////////////////////////////////////////////////////////////
+/////////////////          Snapshots           //////////////
+////////////////////////////////////////////////////////////
+
+struct HistogramSnapshot
+{
+    uint64_t buckets[PROFILER_BUCKETS] = {};
+    uint64_t count = 0;
+    uint64_t total = 0;
+    uint64_t max = 0;
+
+    void Merge(NativeProfilerHistogram& histogram)
+    {
+        for (int i = 0; i < PROFILER_BUCKETS; i++)
+        {
+            uint64_t value = histogram.buckets[i].load(std::memory_order_relaxed);
+            buckets[i] += value;
+            count += value;
+        }
+        total += histogram.total.load(std::memory_order_relaxed);
+
+        uint64_t histogramMax = histogram.max.load(std::memory_order_relaxed);
+        if (histogramMax > max) max = histogramMax;
+    }
+
+    uint64_t Percentile(double percentile)
+    {
+        if (count == 0) return 0;
+
+        uint64_t target = (uint64_t)(percentile * (double)count);
+        if (target == 0) target = 1;
+
+        uint64_t seen = 0;
+        for (int i = 0; i < PROFILER_BUCKETS; i++)
+        {
+            seen += buckets[i];
+            if (seen >= target)
+            {
+                uint64_t bound = BucketUpperBound(i);
+                return bound < max ? bound : max;
+            }
+        }
+        return max;
+    }
+
+    uint64_t Mean()
+    {
+        return count == 0 ? 0 : total / count;
+    }
+};
+
+struct EntrySnapshot
+{
+    uint64_t calls = 0;
+    HistogramSnapshot inclusive;
+    HistogramSnapshot exclusive;
+    HistogramSnapshot hooks;
+};
+
+static const char* profilerKindNames[] = { "function", "class_function", "member_get", "member_set" };
+
+static std::map<std::pair<int, std::string>, EntrySnapshot> TakeSnapshot()
+{
+    std::map<std::pair<int, std::string>, EntrySnapshot> snapshot;
+
+    uint64_t latest = profilerResetGeneration.load(std::memory_order_acquire);
+
+    std::lock_guard<std::mutex> lock(profilerThreadsMutex);
+    for (auto thread : profilerThreads)
+    {
+        // Everything this thread recorded predates the last reset.
+        if (thread->generation.load(std::memory_order_acquire) != latest) continue;
+
+        std::lock_guard<std::mutex> threadLock(thread->mutex);
+        for (int kind = 0; kind < (int)NativeProfilerKind::Count; kind++)
+        {
+            for (auto& entry : thread->entries[kind])
+            {
+                uint64_t calls = entry.second->calls.load(std::memory_order_relaxed);
+                if (calls == 0) continue;
+
+                EntrySnapshot& out = snapshot[{ kind, entry.first }];
+                out.calls += calls;
+                out.inclusive.Merge(entry.second->inclusive);
+                out.exclusive.Merge(entry.second->exclusive);
+                out.hooks.Merge(entry.second->hooks);
+            }
+        }
+    }
+
+    return snapshot;
+}
+
+static std::string EscapeJSON(const std::string& str)
+{
+    std::string out;
+    for (char c : str)
+    {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += c;
+        }
+        else if ((unsigned char)c < 0x20) {
+            char buf[8];
+            snprintf(buf, sizeof(buf), "\\u%04x", (unsigned char)c);
+            out += buf;
+        }
+        else out += c;
+    }
+    return out;
+}
+
+static std::string HistogramJSON(HistogramSnapshot& histogram)
+{
+    std::string out = "{\"total\":" + std::to_string(histogram.total) +
+        ",\"mean\":" + std::to_string(histogram.Mean()) +
+        ",\"p50\":" + std::to_string(histogram.Percentile(0.5)) +
+        ",\"p90\":" + std::to_string(histogram.Percentile(0.9)) +
+        ",\"p99\":" + std::to_string(histogram.Percentile(0.99)) +
+        ",\"p999\":" + std::to_string(histogram.Percentile(0.999)) +
+        ",\"max\":" + std::to_string(histogram.max) +
+        ",\"buckets\":[";
+
+    bool first = true;
+    for (int i = 0; i < PROFILER_BUCKETS; i++)
+    {
+        if (histogram.buckets[i] == 0) continue;
+        if (!first) out += ",";
+        out += "[" + std::to_string(BucketUpperBound(i)) + "," + std::to_string(histogram.buckets[i]) + "]";
+        first = false;
+    }
+
+    return out + "]}";
+}
+
+std::string DumpNativeProfilerJSON()
+{
+    auto snapshot = TakeSnapshot();
+
+    std::string out = "{\"unit\":\"ns\",\"natives\":[";
+    bool first = true;
+    for (auto& entry : snapshot)
+    {
+        if (!first) out += ",";
+        first = false;
+
+        out += "{\"kind\":\"" + std::string(profilerKindNames[entry.first.first]) + "\"";
+        out += ",\"key\":\"" + EscapeJSON(entry.first.second) + "\"";
+        out += ",\"calls\":" + std::to_string(entry.second.calls);
+        out += ",\"inclusive\":" + HistogramJSON(entry.second.inclusive);
+        out += ",\"exclusive\":" + HistogramJSON(entry.second.exclusive);
+        out += ",\"hooks\":" + HistogramJSON(entry.second.hooks);
+        out += "}";
+    }
+
+    return out + "]}";
+}
+
+static std::string HistogramCSV(HistogramSnapshot& histogram)
+{
+    return std::to_string(histogram.total) + "," + std::to_string(histogram.Mean()) + "," +
+        std::to_string(histogram.Percentile(0.5)) + "," + std::to_string(histogram.Percentile(0.99)) + "," +
+        std::to_string(histogram.max);
+}
+
+std::string DumpNativeProfilerCSV()
+{
+    auto snapshot = TakeSnapshot();
+
+    std::string out = "kind,key,calls,"
+        "inclusive_total,inclusive_mean,inclusive_p50,inclusive_p99,inclusive_max,"
+        "exclusive_total,exclusive_mean,exclusive_p50,exclusive_p99,exclusive_max,"
+        "hooks_total,hooks_mean,hooks_p50,hooks_p99,hooks_max\n";
+
+    for (auto& entry : snapshot)
+    {
+        std::string key;
+        for (char c : entry.first.second)
+        {
+            if (c == '"') key += '"';
+            key += c;
+        }
+
+        out += std::string(profilerKindNames[entry.first.first]) + ",\"" + key + "\"," + std::to_string(entry.second.calls) + ",";
+        out += HistogramCSV(entry.second.inclusive) + ",";
+        out += HistogramCSV(entry.second.exclusive) + ",";
+        out += HistogramCSV(entry.second.hooks) + "\n";
+    }
+
+    return out;
+}
@@ -0,0 +1,92 @@
+#ifndef _embedder_internal_native_profiler_h
+#define _embedder_internal_native_profiler_h
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+// Opt-in timing of every native dispatch (functions, class functions, member get/set, for Lua and .NET).
+// Each thread records into its own histograms, so the dispatch path never takes a lock once a key has been seen.
+
+enum class NativeProfilerKind
+{
+    Function,
+    ClassFunction,
+    MemberGet,
+    MemberSet,
+    Count
+};
+
+extern std::atomic<bool> nativeProfilerEnabled;
+
+inline bool IsNativeProfilerEnabled()
+{
+    return nativeProfilerEnabled.load(std::memory_order_relaxed);
+}
+
+void EnableNativeProfiler(bool state);
+// Threads drop their own counters on their next dispatch, snapshots leave them out until then.
+void ResetNativeProfiler();
+
+// Snapshots of everything recorded so far, merged over all threads. Times are in nanoseconds.
+std::string DumpNativeProfilerJSON();
+std::string DumpNativeProfilerCSV();
+
+struct NativeProfilerEntry;
+
+int64_t NativeProfilerNow();
+
+// Times one dispatch. Time spent inside nested dispatches is excluded from the exclusive time,
+// time spent between HooksBegin/HooksEnd is reported separately as hook time.
+class NativeProfilerScope
+{
+private:
+    NativeProfilerEntry* m_entry = nullptr;
+    NativeProfilerScope* m_parent = nullptr;
+    int64_t m_start = 0;
+    int64_t m_hooksStart = 0;
+    int64_t m_hooksTime = 0;
+    int64_t m_childTime = 0;
+
+    void Begin(NativeProfilerKind kind, const std::string& key);
+    void End();
+
+public:
+    NativeProfilerScope(NativeProfilerKind kind, const std::string& key)
+    {
+        if (IsNativeProfilerEnabled()) Begin(kind, key);
+    }
+
+    NativeProfilerScope(NativeProfilerKind kind, const char* key)
+    {
+        if (key && IsNativeProfilerEnabled()) Begin(kind, key);
+    }
+
+    ~NativeProfilerScope()
+    {
+        if (m_entry) End();
+    }
+
+    NativeProfilerScope(const NativeProfilerScope&) = delete;
+    NativeProfilerScope& operator=(const NativeProfilerScope&) = delete;
+
+    void HooksBegin()
+    {
+        if (m_entry) m_hooksStart = NativeProfilerNow();
+    }
+
+    void HooksEnd()
+    {
+        if (!m_entry || m_hooksStart == 0) return;
+
+        m_hooksTime += NativeProfilerNow() - m_hooksStart;
+        m_hooksStart = 0;
+    }
+
+    bool InHooks()
+    {
+        return m_hooksStart != 0;
+    }
+};
+
+#endif
@@ -0,0 +1,108 @@
+#ifndef _embedder_internal_prepared_call_h
+#define _embedder_internal_prepared_call_h
+
+#include <lua.hpp>
+
+#include <type_traits>
+
+#include "Context.h"
+#include "Exception.h"
+#include "Helpers.h"
+#include "Stack.h"
+#include "Value.h"
+
+template<typename Signature>
+class EPreparedCall;
+
+// A Lua function prepared for being called many times with the same signature, e.g. an event callback.
+// The function and the message handler are kept on a thread of their own, so a call only pushes the arguments,
+// runs one lua_pcall and reads the result straight into R, without any registry traffic.
+// Like EValue, it has to be destroyed before its context. Dotnet contexts go through EValue::operator().
+template<typename R, typename... Args>
+class EPreparedCall<R(Args...)>
+{
+private:
+    EContext* m_ctx = nullptr;
+    lua_State* m_thread = nullptr;
+    int m_threadRef = LUA_NOREF;
+    EValue m_function;
+    // Calls of this object in progress, see operator().
+    int m_depth = 0;
+
+    struct DepthScope
+    {
+        int& depth;
+        DepthScope(int& d) : depth(d) { depth++; }
+        ~DepthScope() { depth--; }
+    };
+
+public:
+    EPreparedCall(EValue& function) : m_ctx(function.getContext()), m_function(function)
+    {
+        if (m_ctx->GetKind() != ContextKinds::Lua) return;
+
+        lua_State* L = m_ctx->GetLuaState();
+        m_thread = lua_newthread(L);
+        m_threadRef = luaL_ref(L, LUA_REGISTRYINDEX);
+
+        // thread stack: 1 = message handler, 2 = function
+        lua_rawgetp(m_thread, LUA_REGISTRYINDEX, getMessageHandlerKey());
+        lua_rawgeti(m_thread, LUA_REGISTRYINDEX, function.m_ref);
+    }
+
+    ~EPreparedCall()
+    {
+        if (m_threadRef != LUA_NOREF) luaL_unref(m_ctx->GetMainLuaState(), LUA_REGISTRYINDEX, m_threadRef);
+    }
+
+    EPreparedCall(const EPreparedCall&) = delete;
+    EPreparedCall& operator=(const EPreparedCall&) = delete;
+
+    R operator()(Args... args)
+    {
+        if (m_ctx->GetKind() != ContextKinds::Lua) {
+            EValue result = m_function(args...);
+            if constexpr (!std::is_void<R>::value) return result.template cast<R>();
+            else return;
+        }
+
+        lua_State* L = m_thread;
+        EActiveStateScope active(m_ctx, L);
+        EScriptCallScope call(m_ctx);
+
+        m_ctx->SyncLuaHook(L);
+
+        int base = lua_gettop(L);
+        int handler = 1;
+        luaL_checkstack(L, (int)sizeof...(Args) + 2, nullptr);
+
+        // Re-entered from a native the function called, which runs on the same thread: the stack belongs to
+        // that native's frame now, whatever its height, so the handler and the function are pushed above it.
+        bool reentered = m_depth > 0;
+        DepthScope depth(m_depth);
+        if (reentered) {
+            lua_rawgetp(L, LUA_REGISTRYINDEX, getMessageHandlerKey());
+            handler = lua_gettop(L);
+            lua_rawgeti(L, LUA_REGISTRYINDEX, m_function.m_ref);
+        }
+        else lua_pushvalue(L, 2);
+        (Stack<Args>::pushLua(m_ctx, args), ...);
+
+        if (lua_pcall(L, sizeof...(Args), std::is_void<R>::value ? 0 : 1, handler) != LUA_OK) {
+            EException error(L, ContextKinds::Lua, 1);
+            lua_settop(L, base);
+            EException::Throw(error);
+        }
+
+        if constexpr (std::is_void<R>::value) {
+            lua_settop(L, base);
+        }
+        else {
+            R result = Stack<R>::getLua(m_ctx, -1);
+            lua_settop(L, base);
+            return result;
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,122 @@
+#include "Context.h"
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+
+#define PROFILER_MAX_DEPTH 64
+
+static int64_t ProfilerNowMicroseconds()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static std::string ProfilerFrameName(lua_Debug& ar)
+{
+    std::string name;
+    if (*ar.what == 'C')
+        name = std::string("[C] ") + (ar.name ? ar.name : "?");
+    else if (*ar.what == 'm')
+        name = std::string("main (") + ar.short_src + ")";
+    else
+        name = std::string(ar.name ? ar.name : "anonymous") + " (" + ar.short_src + ":" + std::to_string(ar.linedefined) + ")";
+
+    // ';' separates frames in the folded format.
+    std::replace(name.begin(), name.end(), ';', ':');
+    return name;
+}
+
+void EContext::StartScriptProfiler(int instruction_period, int64_t time_period_us)
+{
+    if (m_kind != ContextKinds::Lua)
+        return;
+
+    m_profilerRunning = true;
+    m_profilerPeriod = instruction_period > 0 ? instruction_period : 1;
+    m_profilerTimePeriod = time_period_us > 0 ? time_period_us : 0;
+    m_profilerLastSample = ProfilerNowMicroseconds();
+    m_profilerInstructions = 0;
+    UpdateLuaHook();
+}
+
+void EContext::StopScriptProfiler()
+{
+    m_profilerRunning = false;
+    UpdateLuaHook();
+}
+
+bool EContext::IsScriptProfilerRunning()
+{
+    return m_profilerRunning;
+}
+
+// Frames are identified by where their function is defined, which unlike its address can't be taken over by
+// another function once it's collected. C functions are told apart by name. Names are only resolved the first
+// time a frame is seen.
+void EContext::SampleScriptProfiler(lua_State* L)
+{
+    if (m_profilerTimePeriod > 0)
+    {
+        int64_t now = ProfilerNowMicroseconds();
+        if (now - m_profilerLastSample < m_profilerTimePeriod)
+            return;
+        m_profilerLastSample = now;
+    }
+
+    size_t frames[PROFILER_MAX_DEPTH];
+    int depth = 0;
+    std::string key;
+
+    lua_Debug ar;
+    for (int level = 0; depth < PROFILER_MAX_DEPTH && lua_getstack(L, level, &ar); level++)
+    {
+        lua_getinfo(L, "S", &ar);
+        if (*ar.what == 'C')
+        {
+            lua_getinfo(L, "n", &ar);
+            key.assign("[C] ").append(ar.name ? ar.name : "?");
+        }
+        else
+            key.assign(ar.source, ar.srclen).append(":").append(std::to_string(ar.linedefined));
+
+        auto it = m_profilerFrameIds.find(key);
+        if (it == m_profilerFrameIds.end())
+        {
+            lua_getinfo(L, "n", &ar);
+            it = m_profilerFrameIds.insert({ key, m_profilerFrameNames.size() }).first;
+            m_profilerFrameNames.push_back(ProfilerFrameName(ar));
+        }
+
+        frames[depth++] = it->second;
+    }
+
+    if (depth == 0)
+        return;
+
+    // Stored outermost frame first, as the folded format expects.
+    std::vector<size_t> stack(frames, frames + depth);
+    std::reverse(stack.begin(), stack.end());
+    m_profilerSamples[stack]++;
+}
+
+std::string EContext::GetScriptProfile()
+{
+    std::string out;
+    for (auto& sample : m_profilerSamples)
+    {
+        for (size_t i = 0; i < sample.first.size(); i++)
+        {
+            if (i != 0) out += ";";
+            out += m_profilerFrameNames[sample.first[i]];
+        }
+        out += " " + std::to_string(sample.second) + "\n";
+    }
+    return out;
+}
+
+void EContext::ResetScriptProfile()
+{
+    m_profilerSamples.clear();
+    m_profilerFrameIds.clear();
+    m_profilerFrameNames.clear();
+}
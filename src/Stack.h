@@ -8,6 +8,7 @@
 #include <map>
 #include <unordered_map>
 #include <utility>
+#include <tuple>
 #include <typeinfo>
 #include <any>
 #include <cstdint>
@@ -35,6 +36,12 @@ struct is_map<std::map<K, V, Args...>> : std::true_type {};
 template<typename K, typename V, typename...Args>
 struct is_map<std::unordered_map<K, V, Args...>> : std::true_type {};
 
+template<typename T>
+struct is_tuple : std::false_type {};
+
+template<typename...Args>
+struct is_tuple<std::tuple<Args...>> : std::true_type {};
+
 template <class T>
 struct Stack;
 
@@ -94,7 +101,7 @@ struct Stack<nullptr_t>
     static bool isDotnetInstance(EContext* ctx, CallContext* context, int argument)
     {
         if (argument == -1) return context->GetReturnType() == 0;
-        else context->GetArgumentType(argument) == 0;
+        else return context->GetArgumentType(argument) == 0;
     }
 };
 
@@ -114,11 +121,11 @@ struct Stack<int>
     static void pushDotnet(EContext* ctx, CallContext* context, int value, bool shouldReturn = false)
     {
         if (shouldReturn) {
-            context->SetReturnType(typesMap[typeid(int)]);
+            context->SetReturnType(DotnetTypeTag<int>::value);
             context->SetResult(value);
         }
         else {
-            context->SetArgumentType(context->GetArgumentCount(), typesMap[typeid(int)]);
+            context->SetArgumentType(context->GetArgumentCount(), DotnetTypeTag<int>::value);
             context->PushArgument(value);
         }
     }
@@ -151,8 +158,8 @@ struct Stack<int>
 
     static bool IsDotnetInstance(EContext* ctx, CallContext* context, int index)
     {
-        if (index == -1) return context->GetReturnType() == typesMap[typeid(int)];
-        else return context->GetArgumentType(index) == typesMap[typeid(int)];
+        if (index == -1) return context->GetReturnType() == DotnetTypeTag<int>::value;
+        else return context->GetArgumentType(index) == DotnetTypeTag<int>::value;
     }
 };
 
@@ -172,11 +179,11 @@ struct Stack<long int>
     static void pushDotnet(EContext* ctx, CallContext* context, long int value, bool shouldReturn = false)
     {
         if (shouldReturn) {
-            context->SetReturnType(typesMap[typeid(int)]);
+            context->SetReturnType(DotnetTypeTag<int>::value);
             context->SetResult(value);
         }
         else {
-            context->SetArgumentType(context->GetArgumentCount(), typesMap[typeid(int)]);
+            context->SetArgumentType(context->GetArgumentCount(), DotnetTypeTag<int>::value);
             context->PushArgument(value);
         }
     }
@@ -209,8 +216,8 @@ struct Stack<long int>
 
     static bool IsDotnetInstance(EContext* ctx, CallContext* context, int index)
     {
-        if (index == -1) return context->GetReturnType() == typesMap[typeid(int)];
-        else return context->GetArgumentType(index) == typesMap[typeid(int)];
+        if (index == -1) return context->GetReturnType() == DotnetTypeTag<int>::value;
+        else return context->GetArgumentType(index) == DotnetTypeTag<int>::value;
     }
 };
 
@@ -230,11 +237,11 @@ struct Stack<unsigned int>
     static void pushDotnet(EContext* ctx, CallContext* context, unsigned int value, bool shouldReturn = false)
     {
         if (shouldReturn) {
-            context->SetReturnType(typesMap[typeid(unsigned int)]);
+            context->SetReturnType(DotnetTypeTag<unsigned int>::value);
             context->SetResult(value);
         }
         else {
-            context->SetArgumentType(context->GetArgumentCount(), typesMap[typeid(unsigned int)]);
+            context->SetArgumentType(context->GetArgumentCount(), DotnetTypeTag<unsigned int>::value);
             context->PushArgument(value);
         }
     }
@@ -262,8 +269,8 @@ struct Stack<unsigned int>
 
     static bool IsDotnetInstance(EContext* ctx, CallContext* context, int index)
     {
-        if (index == -1) return context->GetReturnType() == typesMap[typeid(unsigned int)];
-        else return context->GetArgumentType(index) == typesMap[typeid(unsigned int)];
+        if (index == -1) return context->GetReturnType() == DotnetTypeTag<unsigned int>::value;
+        else return context->GetArgumentType(index) == DotnetTypeTag<unsigned int>::value;
     }
 };
 
@@ -283,11 +290,11 @@ struct Stack<long unsigned int>
     static void pushDotnet(EContext* ctx, CallContext* context, long unsigned int value, bool shouldReturn = false)
     {
         if (shouldReturn) {
-            context->SetReturnType(typesMap[typeid(unsigned int)]);
+            context->SetReturnType(DotnetTypeTag<unsigned int>::value);
             context->SetResult(value);
         }
         else {
-            context->SetArgumentType(context->GetArgumentCount(), typesMap[typeid(unsigned int)]);
+            context->SetArgumentType(context->GetArgumentCount(), DotnetTypeTag<unsigned int>::value);
             context->PushArgument(value);
         }
     }
@@ -315,8 +322,8 @@ struct Stack<long unsigned int>
 
     static bool IsDotnetInstance(EContext* ctx, CallContext* context, int index)
     {
-        if (index == -1) return context->GetReturnType() == typesMap[typeid(unsigned int)];
-        else return context->GetArgumentType(index) == typesMap[typeid(unsigned int)];
+        if (index == -1) return context->GetReturnType() == DotnetTypeTag<unsigned int>::value;
+        else return context->GetArgumentType(index) == DotnetTypeTag<unsigned int>::value;
     }
 };
 
@@ -336,11 +343,11 @@ struct Stack<uint8_t>
     static void pushDotnet(EContext* ctx, CallContext* context, uint8_t value, bool shouldReturn = false)
     {
         if (shouldReturn) {
-            context->SetReturnType(typesMap[typeid(uint8_t)]);
+            context->SetReturnType(DotnetTypeTag<uint8_t>::value);
             context->SetResult(value);
         }
         else {
-            context->SetArgumentType(context->GetArgumentCount(), typesMap[typeid(uint8_t)]);
+            context->SetArgumentType(context->GetArgumentCount(), DotnetTypeTag<uint8_t>::value);
             context->PushArgument(value);
         }
     }
@@ -368,8 +375,8 @@ struct Stack<uint8_t>
 
     static bool IsDotnetInstance(EContext* ctx, CallContext* context, int index)
     {
-        if (index == -1) return context->GetReturnType() == typesMap[typeid(uint8_t)];
-        else return context->GetArgumentType(index) == typesMap[typeid(uint8_t)];
+        if (index == -1) return context->GetReturnType() == DotnetTypeTag<uint8_t>::value;
+        else return context->GetArgumentType(index) == DotnetTypeTag<uint8_t>::value;
     }
 };
 
@@ -389,11 +396,11 @@ struct Stack<int16_t>
     static void pushDotnet(EContext* ctx, CallContext* context, int16_t value, bool shouldReturn = false)
     {
         if (shouldReturn) {
-            context->SetReturnType(typesMap[typeid(short)]);
+            context->SetReturnType(DotnetTypeTag<short>::value);
             context->SetResult(value);
         }
         else {
-            context->SetArgumentType(context->GetArgumentCount(), typesMap[typeid(short)]);
+            context->SetArgumentType(context->GetArgumentCount(), DotnetTypeTag<short>::value);
             context->PushArgument(value);
         }
     }
@@ -421,8 +428,8 @@ struct Stack<int16_t>
 
     static bool IsDotnetInstance(EContext* ctx, CallContext* context, int index)
     {
-        if (index == -1) return context->GetReturnType() == typesMap[typeid(short)];
-        else return context->GetArgumentType(index) == typesMap[typeid(short)];
+        if (index == -1) return context->GetReturnType() == DotnetTypeTag<short>::value;
+        else return context->GetArgumentType(index) == DotnetTypeTag<short>::value;
     }
 };
 
@@ -442,11 +449,11 @@ struct Stack<uint16_t>
     static void pushDotnet(EContext* ctx, CallContext* context, uint16_t value, bool shouldReturn = false)
     {
         if (shouldReturn) {
-            context->SetReturnType(typesMap[typeid(unsigned short)]);
+            context->SetReturnType(DotnetTypeTag<unsigned short>::value);
             context->SetResult(value);
         }
         else {
-            context->SetArgumentType(context->GetArgumentCount(), typesMap[typeid(unsigned short)]);
+            context->SetArgumentType(context->GetArgumentCount(), DotnetTypeTag<unsigned short>::value);
             context->PushArgument(value);
         }
     }
@@ -474,8 +481,8 @@ struct Stack<uint16_t>
 
     static bool IsDotnetInstance(EContext* ctx, CallContext* context, int index)
     {
-        if (index == -1) return context->GetReturnType() == typesMap[typeid(unsigned short)];
-        else return context->GetArgumentType(index) == typesMap[typeid(unsigned short)];
+        if (index == -1) return context->GetReturnType() == DotnetTypeTag<unsigned short>::value;
+        else return context->GetArgumentType(index) == DotnetTypeTag<unsigned short>::value;
     }
 };
 
@@ -495,11 +502,11 @@ struct Stack<int8_t>
     static void pushDotnet(EContext* ctx, CallContext* context, int8_t value, bool shouldReturn = false)
     {
         if (shouldReturn) {
-            context->SetReturnType(typesMap[typeid(int8_t)]);
+            context->SetReturnType(DotnetTypeTag<int8_t>::value);
             context->SetResult(value);
         }
         else {
-            context->SetArgumentType(context->GetArgumentCount(), typesMap[typeid(int8_t)]);
+            context->SetArgumentType(context->GetArgumentCount(), DotnetTypeTag<int8_t>::value);
             context->PushArgument(value);
         }
     }
@@ -527,8 +534,8 @@ struct Stack<int8_t>
 
     static bool IsDotnetInstance(EContext* ctx, CallContext* context, int index)
     {
-        if (index == -1) return context->GetReturnType() == typesMap[typeid(int8_t)];
-        else return context->GetArgumentType(index) == typesMap[typeid(int8_t)];
+        if (index == -1) return context->GetReturnType() == DotnetTypeTag<int8_t>::value;
+        else return context->GetArgumentType(index) == DotnetTypeTag<int8_t>::value;
     }
 };
 
@@ -548,11 +555,11 @@ struct Stack<long long int>
     static void pushDotnet(EContext* ctx, CallContext* context, long long int value, bool shouldReturn = false)
     {
         if (shouldReturn) {
-            context->SetReturnType(typesMap[typeid(int64_t)]);
+            context->SetReturnType(DotnetTypeTag<int64_t>::value);
             context->SetResult(value);
         }
         else {
-            context->SetArgumentType(context->GetArgumentCount(), typesMap[typeid(int64_t)]);
+            context->SetArgumentType(context->GetArgumentCount(), DotnetTypeTag<int64_t>::value);
             context->PushArgument(value);
         }
     }
@@ -580,8 +587,8 @@ struct Stack<long long int>
 
     static bool IsDotnetInstance(EContext* ctx, CallContext* context, int index)
     {
-        if (index == -1) return context->GetReturnType() == typesMap[typeid(int64_t)];
-        else return context->GetArgumentType(index) == typesMap[typeid(int64_t)];
+        if (index == -1) return context->GetReturnType() == DotnetTypeTag<int64_t>::value;
+        else return context->GetArgumentType(index) == DotnetTypeTag<int64_t>::value;
     }
 };
 
@@ -601,11 +608,11 @@ struct Stack<long long unsigned int>
     static void pushDotnet(EContext* ctx, CallContext* context, long long unsigned int value, bool shouldReturn = false)
     {
         if (shouldReturn) {
-            context->SetReturnType(typesMap[typeid(uint64_t)]);
+            context->SetReturnType(DotnetTypeTag<uint64_t>::value);
             context->SetResult(value);
         }
         else {
-            context->SetArgumentType(context->GetArgumentCount(), typesMap[typeid(uint64_t)]);
+            context->SetArgumentType(context->GetArgumentCount(), DotnetTypeTag<uint64_t>::value);
             context->PushArgument(value);
         }
     }
@@ -633,8 +640,8 @@ struct Stack<long long unsigned int>
 
     static bool IsDotnetInstance(EContext* ctx, CallContext* context, int index)
     {
-        if (index == -1) return context->GetReturnType() == typesMap[typeid(uint64_t)];
-        else return context->GetArgumentType(index) == typesMap[typeid(uint64_t)];
+        if (index == -1) return context->GetReturnType() == DotnetTypeTag<uint64_t>::value;
+        else return context->GetArgumentType(index) == DotnetTypeTag<uint64_t>::value;
     }
 };
 
@@ -654,11 +661,11 @@ struct Stack<float>
     static void pushDotnet(EContext* ctx, CallContext* context, float value, bool shouldReturn = false)
     {
         if (shouldReturn) {
-            context->SetReturnType(typesMap[typeid(float)]);
+            context->SetReturnType(DotnetTypeTag<float>::value);
             context->SetResult(value);
         }
         else {
-            context->SetArgumentType(context->GetArgumentCount(), typesMap[typeid(float)]);
+            context->SetArgumentType(context->GetArgumentCount(), DotnetTypeTag<float>::value);
             context->PushArgument(value);
         }
     }
@@ -686,8 +693,8 @@ struct Stack<float>
 
     static bool IsDotnetInstance(EContext* ctx, CallContext* context, int index)
     {
-        if (index == -1) return context->GetReturnType() == typesMap[typeid(float)];
-        else return context->GetArgumentType(index) == typesMap[typeid(float)];
+        if (index == -1) return context->GetReturnType() == DotnetTypeTag<float>::value;
+        else return context->GetArgumentType(index) == DotnetTypeTag<float>::value;
     }
 };
 
@@ -707,11 +714,11 @@ struct Stack<double>
     static void pushDotnet(EContext* ctx, CallContext* context, double value, bool shouldReturn = false)
     {
         if (shouldReturn) {
-            context->SetReturnType(typesMap[typeid(double)]);
+            context->SetReturnType(DotnetTypeTag<double>::value);
             context->SetResult(value);
         }
         else {
-            context->SetArgumentType(context->GetArgumentCount(), typesMap[typeid(double)]);
+            context->SetArgumentType(context->GetArgumentCount(), DotnetTypeTag<double>::value);
             context->PushArgument(value);
         }
     }
@@ -739,8 +746,8 @@ struct Stack<double>
 
     static bool IsDotnetInstance(EContext* ctx, CallContext* context, int index)
     {
-        if (index == -1) return context->GetReturnType() == typesMap[typeid(double)];
-        else return context->GetArgumentType(index) == typesMap[typeid(double)];
+        if (index == -1) return context->GetReturnType() == DotnetTypeTag<double>::value;
+        else return context->GetArgumentType(index) == DotnetTypeTag<double>::value;
     }
 };
 
@@ -760,11 +767,11 @@ struct Stack<bool>
     static void pushDotnet(EContext* ctx, CallContext* context, bool value, bool shouldReturn = false)
     {
         if (shouldReturn) {
-            context->SetReturnType(typesMap[typeid(bool)]);
+            context->SetReturnType(DotnetTypeTag<bool>::value);
             context->SetResult(value);
         }
         else {
-            context->SetArgumentType(context->GetArgumentCount(), typesMap[typeid(bool)]);
+            context->SetArgumentType(context->GetArgumentCount(), DotnetTypeTag<bool>::value);
             context->PushArgument(value);
         }
     }
@@ -792,8 +799,8 @@ struct Stack<bool>
 
     static bool IsDotnetInstance(EContext* ctx, CallContext* context, int index)
     {
-        if (index == -1) return context->GetReturnType() == typesMap[typeid(bool)];
-        else return context->GetArgumentType(index) == typesMap[typeid(bool)];
+        if (index == -1) return context->GetReturnType() == DotnetTypeTag<bool>::value;
+        else return context->GetArgumentType(index) == DotnetTypeTag<bool>::value;
     }
 };
 
@@ -816,11 +823,11 @@ struct Stack<char>
     static void pushDotnet(EContext* ctx, CallContext* context, char value, bool shouldReturn = false)
     {
         if (shouldReturn) {
-            context->SetReturnType(typesMap[typeid(std::string)]);
+            context->SetReturnType(DotnetTypeTag<std::string>::value);
             context->SetResult(std::string(1, value));
         }
         else {
-            context->SetArgumentType(context->GetArgumentCount(), typesMap[typeid(std::string)]);
+            context->SetArgumentType(context->GetArgumentCount(), DotnetTypeTag<std::string>::value);
             context->PushArgument(std::string(1, value));
         }
     }
@@ -848,8 +855,8 @@ struct Stack<char>
 
     static bool IsDotnetInstance(EContext* ctx, CallContext* context, int index)
     {
-        if (index == -1) return context->GetReturnType() == typesMap[typeid(std::string)];
-        else return context->GetArgumentType(index) == typesMap[typeid(std::string)];
+        if (index == -1) return context->GetReturnType() == DotnetTypeTag<std::string>::value;
+        else return context->GetArgumentType(index) == DotnetTypeTag<std::string>::value;
     }
 };
 
@@ -876,11 +883,11 @@ struct Stack<char const*>
     static void pushDotnet(EContext* ctx, CallContext* context, char const* value, bool shouldReturn = false)
     {
         if (shouldReturn) {
-            context->SetReturnType(typesMap[typeid(std::string)]);
+            context->SetReturnType(DotnetTypeTag<std::string>::value);
             context->SetResult(std::string(value));
         }
         else {
-            context->SetArgumentType(context->GetArgumentCount(), typesMap[typeid(std::string)]);
+            context->SetArgumentType(context->GetArgumentCount(), DotnetTypeTag<std::string>::value);
             context->PushArgument(std::string(value));
         }
     }
@@ -908,8 +915,8 @@ struct Stack<char const*>
 
     static bool IsDotnetInstance(EContext* ctx, CallContext* context, int index)
     {
-        if (index == -1) return context->GetReturnType() == typesMap[typeid(std::string)];
-        else return context->GetArgumentType(index) == typesMap[typeid(std::string)];
+        if (index == -1) return context->GetReturnType() == DotnetTypeTag<std::string>::value;
+        else return context->GetArgumentType(index) == DotnetTypeTag<std::string>::value;
     }
 };
 
@@ -933,11 +940,11 @@ struct Stack<std::string>
     static void pushDotnet(EContext* ctx, CallContext* context, std::string& value, bool shouldReturn = false)
     {
         if (shouldReturn) {
-            context->SetReturnType(typesMap[typeid(std::string)]);
+            context->SetReturnType(DotnetTypeTag<std::string>::value);
             context->SetResult(value);
         }
         else {
-            context->SetArgumentType(context->GetArgumentCount(), typesMap[typeid(std::string)]);
+            context->SetArgumentType(context->GetArgumentCount(), DotnetTypeTag<std::string>::value);
             context->PushArgument(value);
         }
     }
@@ -987,8 +994,8 @@ struct Stack<std::string>
 
     static bool IsDotnetInstance(EContext* ctx, CallContext* context, int index)
     {
-        if (index == -1) return context->GetReturnType() == typesMap[typeid(std::string)];
-        else return context->GetArgumentType(index) == typesMap[typeid(std::string)];
+        if (index == -1) return context->GetReturnType() == DotnetTypeTag<std::string>::value;
+        else return context->GetArgumentType(index) == DotnetTypeTag<std::string>::value;
     }
 };
 
@@ -1032,7 +1039,7 @@ struct Stack<std::vector<T>>
         else if constexpr (std::is_same<std::any, T>::value) {
             arrayData->elements = (void**)DotnetAllocateContextPointer(sizeof(void*), value.size());
             arrayData->length = value.size();
-            arrayData->type = typesMap[typeid(void*)];
+            arrayData->type = DotnetTypeTag<void*>::value;
 
             void** arrayPtr = (void**)arrayData->elements;
             for (int i = 0; i < value.size(); i++) {
@@ -1042,7 +1049,7 @@ struct Stack<std::vector<T>>
         else if constexpr (std::is_same<std::string, T>::value) {
             arrayData->elements = (void**)DotnetAllocateContextPointer(sizeof(StringData*), value.size());
             arrayData->length = value.size();
-            arrayData->type = typesMap[typeid(T)];
+            arrayData->type = DotnetTypeTag<T>::value;
 
             char** arrayPtr = (char**)arrayData->elements;
             for (int i = 0; i < value.size(); i++)
@@ -1051,19 +1058,19 @@ struct Stack<std::vector<T>>
         else if constexpr (std::is_same<EValue, T>::value) {
             arrayData->elements = (void**)DotnetAllocateContextPointer(sizeof(void*), value.size());
             arrayData->length = value.size();
-            arrayData->type = typesMap[typeid(void*)];
+            arrayData->type = DotnetTypeTag<void*>::value;
 
             void** arrayPtr = (void**)arrayData->elements;
-            for (int i = 0; i < value.size(); i++)
+            for (size_t i = 0; i < value.size(); i++)
                 arrayPtr[i] = Stack<T>::pushRawDotnet(ctx, context, value[i]).getPointer();
         }
         else {
             arrayData->elements = (void**)DotnetAllocateContextPointer(sizeof(T), value.size());
             arrayData->length = value.size();
-            arrayData->type = typesMap[typeid(T)];
+            arrayData->type = DotnetTypeTag<T>::value;
 
             T* arrayPtr = (T*)arrayData->elements;
-            for (int i = 0; i < value.size(); i++)
+            for (size_t i = 0; i < value.size(); i++)
                 arrayPtr[i] = Stack<T>::pushRawDotnet(ctx, context, value[i]);
         }
         return (T*)arrayData;
@@ -1177,7 +1184,7 @@ struct Stack<std::map<K, V>>
             mapData->keys = (void**)DotnetAllocateContextPointer(sizeof(void*), count);
             void** listKeys = (void**)mapData->keys;
 
-            mapData->key_type = is_map<K>::value ? 16 : (is_vector<K>::value ? 15 : typesMap[typeid(K)]);
+            mapData->key_type = is_map<K>::value ? 16 : (is_vector<K>::value ? 15 : DotnetTypeTag<K>::value);
 
             int i = 0;
             for (auto it = value.begin(); it != value.end(); ++it)
@@ -1190,7 +1197,7 @@ struct Stack<std::map<K, V>>
             mapData->keys = (void**)DotnetAllocateContextPointer(sizeof(K), count);
             K* listKeys = (K*)mapData->keys;
 
-            mapData->key_type = typesMap[typeid(K)];
+            mapData->key_type = DotnetTypeTag<K>::value;
 
             int i = 0;
             for (auto it = value.begin(); it != value.end(); ++it)
@@ -1204,7 +1211,7 @@ struct Stack<std::map<K, V>>
             mapData->values = (void**)DotnetAllocateContextPointer(sizeof(void*), count);
             void** listValues = (void**)mapData->values;
 
-            mapData->key_type = is_map<V>::value ? 16 : (is_vector<V>::value ? 15 : typesMap[typeid(V)]);
+            mapData->value_type = is_map<V>::value ? 16 : (is_vector<V>::value ? 15 : DotnetTypeTag<V>::value);
 
             int i = 0;
             for (auto it = value.begin(); it != value.end(); ++it)
@@ -1217,7 +1224,7 @@ struct Stack<std::map<K, V>>
             mapData->values = (void**)DotnetAllocateContextPointer(sizeof(V), count);
             V* listValues = (V*)mapData->values;
 
-            mapData->value_type = typesMap[typeid(V)];
+            mapData->value_type = DotnetTypeTag<V>::value;
 
             int i = 0;
             for (auto it = value.begin(); it != value.end(); ++it)
@@ -1328,7 +1335,7 @@ struct Stack<std::unordered_map<K, V>>
         if constexpr (is_map<K>::value || is_vector<K>::value || std::is_same<std::string, K>::value) {
             void** listKeys = (void**)mapData->keys;
 
-            mapData->key_type = is_map<K>::value ? 16 : (is_vector<K>::value ? 15 : typesMap[typeid(K)]);
+            mapData->key_type = is_map<K>::value ? 16 : (is_vector<K>::value ? 15 : DotnetTypeTag<K>::value);
 
             int i = 0;
             for (auto it = value.begin(); it != value.end(); ++it)
@@ -1340,7 +1347,7 @@ struct Stack<std::unordered_map<K, V>>
         else {
             K* listKeys = (K*)mapData->keys;
 
-            mapData->key_type = typesMap[typeid(K)];
+            mapData->key_type = DotnetTypeTag<K>::value;
 
             int i = 0;
             for (auto it = value.begin(); it != value.end(); ++it)
@@ -1353,7 +1360,7 @@ struct Stack<std::unordered_map<K, V>>
         if constexpr (is_map<V>::value || is_vector<V>::value || std::is_same<std::string, V>::value) {
             void** listValues = (void**)mapData->values;
 
-            mapData->key_type = is_map<V>::value ? 16 : (is_vector<V>::value ? 15 : typesMap[typeid(V)]);
+            mapData->value_type = is_map<V>::value ? 16 : (is_vector<V>::value ? 15 : DotnetTypeTag<V>::value);
 
             int i = 0;
             for (auto it = value.begin(); it != value.end(); ++it)
@@ -1365,7 +1372,7 @@ struct Stack<std::unordered_map<K, V>>
         else {
             V* listValues = (V*)mapData->values;
 
-            mapData->value_type = typesMap[typeid(V)];
+            mapData->value_type = DotnetTypeTag<V>::value;
 
             int i = 0;
             for (auto it = value.begin(); it != value.end(); ++it)
@@ -1589,11 +1596,11 @@ struct Stack<ClassData*>
         value = pushRawDotnet(ctx, context, value);
 
         if (shouldReturn) {
-            context->SetReturnType(typesMap[typeid(void*)]);
+            context->SetReturnType(DotnetTypeTag<void*>::value);
             context->SetResult(value);
         }
         else {
-            context->SetArgumentType(context->GetArgumentCount(), typesMap[typeid(void*)]);
+            context->SetArgumentType(context->GetArgumentCount(), DotnetTypeTag<void*>::value);
             context->PushArgument(value);
         }
     }
@@ -1622,8 +1629,8 @@ struct Stack<ClassData*>
 
     static bool IsDotnetInstance(EContext* ctx, CallContext* context, int index)
     {
-        if (index == -1) return context->GetReturnType() == typesMap[typeid(void*)];
-        else return context->GetArgumentType(index) == typesMap[typeid(void*)];
+        if (index == -1) return context->GetReturnType() == DotnetTypeTag<void*>::value;
+        else return context->GetArgumentType(index) == DotnetTypeTag<void*>::value;
     }
 };
 
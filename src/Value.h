@@ -2,11 +2,16 @@
 #define _embedder_internal_value_h
 
 #include <lua.hpp>
+#include <algorithm>
+#include <cassert>
+#include <cstring>
 
 #include "Context.h"
 #include "Exception.h"
 #include "Helpers.h"
 #include "Stack.h"
+#include "dotnet/arena.h"
+#include "dotnet/format.h"
 
 class Vector;
 class Vector2D;
@@ -14,6 +19,13 @@ class Vector4D;
 class Color;
 class QAngle;
 
+// Error raised by one of the callbacks of EValue::callEach.
+struct ECallError
+{
+    size_t index;
+    EException error;
+};
+
 class EValue
 {
 private:
@@ -22,11 +34,26 @@ private:
     void* m_ptr = nullptr;
     int m_ptrtype = 0;
 
+    // Dotnet functions: length of the name in m_ptr and its managed handle, both resolved on the first call.
+    int m_nameLen = -1;
+    void* m_handle = nullptr;
+
     void swap(EValue& other)
     {
         std::swap(m_ctx, other.m_ctx);
         std::swap(m_ref, other.m_ref);
         std::swap(m_ptr, other.m_ptr);
+        std::swap(m_ptrtype, other.m_ptrtype);
+        std::swap(m_nameLen, other.m_nameLen);
+        std::swap(m_handle, other.m_handle);
+    }
+
+    void resolveDotnetFunction()
+    {
+        if (m_nameLen >= 0) return;
+
+        m_nameLen = m_ptr ? (int)strlen((const char*)m_ptr) : 0;
+        if (m_nameLen > 0) m_handle = DotnetResolveFunction((const char*)m_ptr, m_nameLen, m_ctx);
     }
 
 public:
@@ -52,6 +79,8 @@ public:
             m_ref = luaL_ref((lua_State*)ctx->GetState(), LUA_REGISTRYINDEX);
         }
         else if (ctx->GetKind() == ContextKinds::Dotnet) {
+            // The value lives as long as the EValue, never in the call arena.
+            EDotnetArenaMarshalScope marshal(false);
             if constexpr (
                 is_map<T>::value || is_vector<T>::value || std::is_same<std::string, T>::value || std::is_same<ClassData*, T>::value || std::is_same<Vector, T>::value ||
                 std::is_same<Vector2D, T>::value || std::is_same<Vector4D, T>::value || std::is_same<Color, T>::value || std::is_same<QAngle, T>::value
@@ -60,14 +89,17 @@ public:
                 m_ptr = val;
             }
             else {
+                // Primitives are stored in the pointer itself, like an argument slot.
                 T val = Stack<T>::pushRawDotnet(ctx, nullptr, value);
-                m_ptr = *(void**)&val;
+                static_assert(sizeof(T) <= sizeof(void*), "EValue stores primitives in its pointer");
+                m_ptr = nullptr;
+                memcpy(&m_ptr, &val, sizeof(T));
             }
 
             if constexpr (is_map<T>::value) m_ptrtype = 16;
             else if constexpr (is_vector<T>::value) m_ptrtype = 15;
-            else if constexpr (std::is_same<std::string, T>::value) m_ptrtype = typesMap[typeid(std::string)];
-            else m_ptrtype = typesMap[typeid(T)];
+            else if constexpr (std::is_same<std::string, T>::value) m_ptrtype = DotnetTypeTag<std::string>::value;
+            else m_ptrtype = DotnetTypeTag<T>::value;
         }
     }
 
@@ -109,6 +141,9 @@ public:
         m_ctx->PushValue(this);
         m_ref = other.createRef();
         m_ptr = other.m_ptr;
+        m_ptrtype = other.m_ptrtype;
+        m_nameLen = other.m_nameLen;
+        m_handle = other.m_handle;
     }
 
     EValue(const EValue& other) {
@@ -118,6 +153,9 @@ public:
         m_ctx->PushValue(this);
         m_ref = nonConstOther.createRef();
         m_ptr = nonConstOther.m_ptr;
+        m_ptrtype = nonConstOther.m_ptrtype;
+        m_nameLen = nonConstOther.m_nameLen;
+        m_handle = nonConstOther.m_handle;
     }
 
     int createRef() {
@@ -166,8 +204,8 @@ public:
         else if (m_ctx->GetKind() == ContextKinds::Dotnet) {
             if constexpr (is_map<T>::value) return m_ptrtype == 16;
             else if constexpr (is_vector<T>::value) return m_ptrtype == 15;
-            else if constexpr (std::is_same<std::string, T>::value) return m_ptrtype == typesMap[typeid(std::string)];
-            else return m_ptrtype == typesMap[typeid(T)];
+            else if constexpr (std::is_same<std::string, T>::value) return m_ptrtype == DotnetTypeTag<std::string>::value;
+            else return m_ptrtype == DotnetTypeTag<T>::value;
         }
         else return false;
     }
@@ -220,7 +258,7 @@ public:
 
     bool isBool() {
         if (m_ctx->GetKind() == ContextKinds::Lua) return getLuaType() == LUA_TBOOLEAN;
-        else if (m_ctx->GetKind() == ContextKinds::Dotnet) return m_ptrtype == typesMap[typeid(bool)];
+        else if (m_ctx->GetKind() == ContextKinds::Dotnet) return m_ptrtype == DotnetTypeTag<bool>::value;
         else return false;
     }
 
@@ -232,7 +270,7 @@ public:
 
     bool isString() {
         if (m_ctx->GetKind() == ContextKinds::Lua) return getLuaType() == LUA_TSTRING;
-        else if (m_ctx->GetKind() == ContextKinds::Dotnet) return m_ptrtype == typesMap[typeid(std::string)];
+        else if (m_ctx->GetKind() == ContextKinds::Dotnet) return m_ptrtype == DotnetTypeTag<std::string>::value;
         else return false;
     }
 
@@ -260,11 +298,7 @@ public:
             return str;
         }
         else if (m_ctx->GetKind() == ContextKinds::Dotnet) {
-            static char out[8192];
-            memset(out, 0, sizeof(out));
-            InterpretAsString((void*)&m_ptr, m_ptrtype, out, sizeof(out));
-
-            return std::string(out);
+            return DotnetFormatValue((void*)&m_ptr, m_ptrtype);
         }
         else return "";
     }
@@ -294,25 +328,160 @@ public:
             return EValue::fromLuaStack(m_ctx);
         }
         else if (m_ctx->GetKind() == ContextKinds::Dotnet) {
+            EDotnetArenaScope arena;
             CallData data;
             data.args_count = 0;
 
             CallContext ctx(data);
 
-            pushDotnetArguments(&ctx, std::forward<Params>(params)...);
+            {
+                EDotnetArenaMarshalScope marshal;
+                pushDotnetArguments(&ctx, std::forward<Params>(params)...);
+            }
 
+            resolveDotnetFunction();
             data.function_str = (const char*)m_ptr;
-            data.function_len = strlen((const char*)m_ptr);
+            data.function_len = m_nameLen;
+            data.function_handle = m_handle;
 
-            DotnetUpdateGlobalStateCleanupLock(true);
+            EDotnetCleanupLock cleanupLock;
             DotnetExecuteFunction(&data, m_ctx);
-            DotnetUpdateGlobalStateCleanupLock(false);
 
             return EValue(m_ctx, ctx.GetResultPtr(), ctx.GetReturnType());
         }
         else return EValue(m_ctx);
     }
 
+    // Calls the function and reads its result straight off the stack as R, without going through an EValue.
+    // R can be void, or a std::tuple to read several results. .NET functions only have one result, which goes
+    // into the first element of the tuple.
+    template<typename R, typename... Params>
+    R call(Params&&... params)
+    {
+        if (m_ctx->GetKind() == ContextKinds::Lua) {
+            lua_State* L = (lua_State*)m_ctx->GetState();
+            int base = lua_gettop(L);
+
+            pushLua();
+            pushLuaArguments(params...);
+            EException::xpcall(m_ctx, sizeof...(params), luaResultCount<R>());
+
+            if constexpr (std::is_void<R>::value) return;
+            else {
+                R result = getLuaResults<R>(base + 1);
+                lua_settop(L, base);
+                return result;
+            }
+        }
+        else {
+            EValue result = (*this)(params...);
+
+            if constexpr (std::is_void<R>::value) return;
+            else if constexpr (is_tuple<R>::value) {
+                R results{};
+                if (m_ctx->GetKind() == ContextKinds::Dotnet)
+                    std::get<0>(results) = result.template cast<std::tuple_element_t<0, R>>();
+                return results;
+            }
+            else return result.template cast<R>();
+        }
+    }
+
+    // Calls every function of `functions` with the same arguments, all of them under a single protected frame
+    // instead of one per function. A failing callback doesn't stop the following ones, its error is returned
+    // along with its index. Results are discarded and the whole batch shares one script budget.
+    // All the functions have to belong to the same context.
+    template<typename... Params>
+    static std::vector<ECallError> callEach(std::vector<EValue>& functions, Params&&... params)
+    {
+        std::vector<ECallError> errors;
+        if (functions.empty()) return errors;
+
+        EContext* ctx = functions[0].m_ctx;
+        assert(std::all_of(functions.begin(), functions.end(), [ctx](const EValue& function) { return function.m_ctx == ctx; }));
+        if (ctx->GetKind() == ContextKinds::Lua) {
+            lua_State* L = (lua_State*)ctx->GetState();
+            EScriptCallScope call(ctx);
+
+            int base = lua_gettop(L);
+            functions[0].pushLuaArguments(params...);
+            int nargs = lua_gettop(L) - base;
+
+            // Checked without raising: an overflow error here wouldn't be caught by the batch's protected frame.
+            if (!lua_checkstack(L, nargs + 3)) {
+                lua_settop(L, base);
+                for (size_t i = 0; i < functions.size(); i++)
+                    errors.push_back({ i, EException(L, ctx->GetKind(), std::string("stack overflow")) });
+                return errors;
+            }
+
+            CallEachBatch batch{ &functions, 0 };
+            while (batch.current < functions.size()) {
+                lua_rawgetp(L, LUA_REGISTRYINDEX, getMessageHandlerKey());
+                int handler = lua_gettop(L);
+                lua_pushcfunction(L, callEachDispatcher);
+                lua_pushlightuserdata(L, &batch);
+                for (int i = 1; i <= nargs; i++) lua_pushvalue(L, base + i);
+
+                // On error the batch resumes with the callback after the failing one.
+                if (lua_pcall(L, nargs + 1, 0, handler) != LUA_OK) {
+                    errors.push_back({ batch.current, EException(L, ctx->GetKind(), 1) });
+                    batch.current++;
+                }
+                lua_settop(L, handler - 1);
+            }
+            lua_settop(L, base);
+        }
+        else if (ctx->GetKind() == ContextKinds::Dotnet) {
+            EDotnetCleanupLock cleanupLock;
+            EDotnetArenaScope arena;
+
+            // The arguments are marshalled once and every function is called in the same transition.
+            CallData data;
+            memset(&data, 0, sizeof(CallData));
+            CallContext call(data);
+            {
+                EDotnetArenaMarshalScope marshal;
+                functions[0].pushDotnetArguments(&call, params...);
+            }
+
+            size_t count = functions.size();
+            std::vector<const char*> names(count);
+            std::vector<int> name_lens(count);
+            std::vector<void*> handles(count);
+            std::vector<uint64_t> return_values(count);
+            std::vector<int> return_types(count), has_return(count);
+            std::vector<StringData> call_errors(count, StringData{ nullptr, 0 });
+
+            for (size_t i = 0; i < count; i++) {
+                functions[i].resolveDotnetFunction();
+                names[i] = functions[i].m_ptr ? (const char*)functions[i].m_ptr : "";
+                name_lens[i] = functions[i].m_nameLen;
+                handles[i] = functions[i].m_handle;
+            }
+
+            BatchCallData batch{ &data, names.data(), name_lens.data(), (int)count, return_values.data(), return_types.data(), has_return.data(), call_errors.data(), handles.data() };
+            if (DotnetExecuteFunctions(&batch, ctx)) {
+                for (size_t i = 0; i < count; i++) {
+                    if (call_errors[i].ptr)
+                        errors.push_back({ i, EException(ctx, ctx->GetKind(), std::string((const char*)call_errors[i].ptr, call_errors[i].len)) });
+                }
+            }
+            else {
+                for (size_t i = 0; i < count; i++) {
+                    try {
+                        functions[i](params...);
+                    }
+                    catch (EException& e) {
+                        errors.push_back({ i, e });
+                    }
+                }
+            }
+        }
+
+        return errors;
+    }
+
     template<class T>
     EValue operator[](T value)
     {
@@ -380,12 +549,54 @@ public:
     }
 
 private:
+    struct CallEachBatch
+    {
+        std::vector<EValue>* functions;
+        size_t current;
+    };
+
+    static int callEachDispatcher(lua_State* L)
+    {
+        CallEachBatch* batch = (CallEachBatch*)lua_touserdata(L, 1);
+        std::vector<EValue>& functions = *batch->functions;
+        int nargs = lua_gettop(L) - 1;
+
+        luaL_checkstack(L, nargs + 1, nullptr);
+        for (; batch->current < functions.size(); batch->current++) {
+            lua_rawgeti(L, LUA_REGISTRYINDEX, functions[batch->current].m_ref);
+            for (int i = 2; i <= nargs + 1; i++) lua_pushvalue(L, i);
+            lua_call(L, nargs, 0);
+        }
+        return 0;
+    }
+
+    template<typename R>
+    static constexpr int luaResultCount()
+    {
+        if constexpr (std::is_void<R>::value) return 0;
+        else if constexpr (is_tuple<R>::value) return (int)std::tuple_size<R>::value;
+        else return 1;
+    }
+
+    template<typename R>
+    R getLuaResults(int index)
+    {
+        if constexpr (is_tuple<R>::value) return getLuaTuple<R>(index, std::make_index_sequence<std::tuple_size<R>::value>{});
+        else return Stack<R>::getLua(m_ctx, index);
+    }
+
+    template<typename R, size_t... I>
+    R getLuaTuple(int index, std::index_sequence<I...>)
+    {
+        return R{ Stack<std::tuple_element_t<I, R>>::getLua(m_ctx, index + (int)I)... };
+    }
+
     void pushLuaArguments() {}
 
     template<typename T, typename... Params>
     void pushLuaArguments(T& param, Params&&... params)
     {
-        Stack<T>::pushLua(m_ctx, param);
+        Stack<std::remove_const_t<T>>::pushLua(m_ctx, param);
         pushLuaArguments(std::forward<Params>(params)...);
     }
 
@@ -394,8 +605,9 @@ private:
     template<typename T, typename... Params>
     void pushDotnetArguments(CallContext* ctx, T& param, Params&&... params)
     {
-        if constexpr (is_map<T>::value || is_vector<T>::value || std::is_same<T, std::any>::value) {
-            ctx->PushArgument<void*>(Stack<T>::pushRawDotnet(m_ctx, ctx, param));
+        using U = std::remove_const_t<T>;
+        if constexpr (is_map<U>::value || is_vector<U>::value || std::is_same<U, std::any>::value) {
+            ctx->PushArgument<void*>(Stack<U>::pushRawDotnet(m_ctx, ctx, param));
         }
         else {
             ctx->PushArgument(param);
@@ -422,11 +634,11 @@ struct Stack<EValue>
         void* val = value.getPointer();
 
         if (shouldReturn) {
-            context->SetReturnType(typesMap[typeid(void*)]);
+            context->SetReturnType(DotnetTypeTag<void*>::value);
             context->SetResult(val);
         }
         else {
-            context->SetArgumentType(context->GetArgumentCount(), typesMap[typeid(void*)]);
+            context->SetArgumentType(context->GetArgumentCount(), DotnetTypeTag<void*>::value);
             context->PushArgument(val);
         }
     }
@@ -0,0 +1,142 @@
+#include "arena.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <vector>
+
+#define ARENA_BLOCK_SIZE (64 * 1024)
+#define ARENA_ALIGNMENT 16
+
+struct ArenaBlock
+{
+    char* data;
+    size_t size;
+    size_t used;
+};
+
+struct DotnetArena
+{
+    std::vector<ArenaBlock> blocks;
+    size_t current = 0;
+    int depth = 0;
+    size_t markBlock = 0;
+    size_t markUsed = 0;
+
+    ~DotnetArena()
+    {
+        for (auto& block : blocks)
+            free(block.data);
+    }
+};
+
+std::atomic<bool> dotnetArenaTickMode = false;
+thread_local DotnetArena dotnetArena;
+thread_local bool dotnetArenaMarshalling = false;
+
+void* DotnetArenaAllocate(size_t bytes)
+{
+    if (!dotnetArenaMarshalling) return nullptr;
+
+    DotnetArena& arena = dotnetArena;
+    if (arena.depth == 0 && !dotnetArenaTickMode.load(std::memory_order_relaxed))
+        return nullptr;
+
+    bytes = (bytes + (ARENA_ALIGNMENT - 1)) & ~(size_t)(ARENA_ALIGNMENT - 1);
+    if (bytes == 0) bytes = ARENA_ALIGNMENT;
+
+    while (arena.current < arena.blocks.size())
+    {
+        ArenaBlock& block = arena.blocks[arena.current];
+        if (block.size - block.used >= bytes)
+        {
+            void* ptr = block.data + block.used;
+            block.used += bytes;
+            return ptr;
+        }
+
+        // Already reserved blocks further down the chain are reused before growing it.
+        if (arena.current + 1 == arena.blocks.size()) break;
+        arena.blocks[++arena.current].used = 0;
+    }
+
+    size_t size = bytes > ARENA_BLOCK_SIZE ? bytes : ARENA_BLOCK_SIZE;
+    char* data = (char*)malloc(size);
+    if (!data) return nullptr;
+
+    arena.blocks.push_back({ data, size, bytes });
+    arena.current = arena.blocks.size() - 1;
+    return data;
+}
+
+// Drops everything allocated after (block, used). Oversized blocks past that point are freed.
+static void ArenaRewind(DotnetArena& arena, size_t block, size_t used)
+{
+    if (arena.blocks.empty()) return;
+
+    for (size_t i = arena.blocks.size(); i-- > block + 1;)
+    {
+        if (arena.blocks[i].size > ARENA_BLOCK_SIZE)
+        {
+            free(arena.blocks[i].data);
+            arena.blocks.erase(arena.blocks.begin() + i);
+        }
+        else arena.blocks[i].used = 0;
+    }
+
+    arena.current = block;
+    arena.blocks[block].used = used;
+}
+
+bool SetDotnetArenaMarshalling(bool state)
+{
+    bool prev = dotnetArenaMarshalling;
+    dotnetArenaMarshalling = state;
+    return prev;
+}
+
+void DotnetArenaBeginCall()
+{
+    DotnetArena& arena = dotnetArena;
+    if (arena.depth++ > 0) return;
+
+    arena.markBlock = arena.current;
+    arena.markUsed = arena.current < arena.blocks.size() ? arena.blocks[arena.current].used : 0;
+}
+
+void DotnetArenaEndCall()
+{
+    DotnetArena& arena = dotnetArena;
+    if (arena.depth == 0 || --arena.depth > 0) return;
+
+    ArenaRewind(arena, arena.markBlock, arena.markUsed);
+}
+
+void SetDotnetArenaTickMode(bool state)
+{
+    dotnetArenaTickMode.store(state, std::memory_order_relaxed);
+}
+
+void DotnetArenaEndTick()
+{
+    DotnetArena& arena = dotnetArena;
+    if (arena.depth > 0) return;
+
+    ArenaRewind(arena, 0, 0);
+}
+
+uint64_t GetDotnetArenaUsedBytes()
+{
+    DotnetArena& arena = dotnetArena;
+    uint64_t used = 0;
+    for (size_t i = 0; i <= arena.current && i < arena.blocks.size(); i++)
+        used += arena.blocks[i].used;
+    return used;
+}
+
+uint64_t GetDotnetArenaReservedBytes()
+{
+    uint64_t reserved = 0;
+    for (auto& block : dotnetArena.blocks)
+        reserved += block.size;
+    return reserved;
+}
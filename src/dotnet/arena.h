@@ -0,0 +1,62 @@
+#ifndef _embedder_src_dotnet_arena_h
+#define _embedder_src_dotnet_arena_h
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Native bump arena for the buffers built while marshalling .NET calls (StringData, ArrayData, MapData and
+ * their contents), so DotnetAllocateContextPointer doesn't call into the managed allocator for each of them.
+ *
+ * Only the marshalling of the arguments and result of one call into its CallContext (EDotnetArenaMarshalScope)
+ * takes memory from the arena, and only while it has a well defined end of life:
+ *  - inside a call scope (EDotnetArenaScope), everything allocated since the outermost scope began is released
+ *    when it ends;
+ *  - with the tick mode on, also outside of scopes, released by DotnetArenaEndTick.
+ * Otherwise DotnetArenaAllocate returns nullptr and the allocation goes to the managed side as before, which is
+ * always the case for values that outlive the call, like the ones held by an EValue.
+ * Blocks are chained when one is full, every thread has its own arena.
+ */
+
+void* DotnetArenaAllocate(size_t bytes);
+
+// Returns the previous state.
+bool SetDotnetArenaMarshalling(bool state);
+
+void DotnetArenaBeginCall();
+void DotnetArenaEndCall();
+
+// The host promises to call DotnetArenaEndTick regularly (e.g. once per frame), which releases everything
+// allocated outside of call scopes. Has no effect while a call scope is open.
+void SetDotnetArenaTickMode(bool state);
+void DotnetArenaEndTick();
+
+// Bytes currently handed out by the calling thread's arena, and the size of its blocks.
+uint64_t GetDotnetArenaUsedBytes();
+uint64_t GetDotnetArenaReservedBytes();
+
+class EDotnetArenaScope
+{
+public:
+    EDotnetArenaScope() { DotnetArenaBeginCall(); }
+    ~EDotnetArenaScope() { DotnetArenaEndCall(); }
+
+    EDotnetArenaScope(const EDotnetArenaScope&) = delete;
+    EDotnetArenaScope& operator=(const EDotnetArenaScope&) = delete;
+};
+
+// Marks what is allocated while alive as call marshalling (true), or as stored values (false).
+class EDotnetArenaMarshalScope
+{
+private:
+    bool m_prev;
+
+public:
+    EDotnetArenaMarshalScope(bool state = true) { m_prev = SetDotnetArenaMarshalling(state); }
+    ~EDotnetArenaMarshalScope() { SetDotnetArenaMarshalling(m_prev); }
+
+    EDotnetArenaMarshalScope(const EDotnetArenaMarshalScope&) = delete;
+    EDotnetArenaMarshalScope& operator=(const EDotnetArenaMarshalScope&) = delete;
+};
+
+#endif
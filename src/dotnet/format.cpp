@@ -0,0 +1,192 @@
+#include "format.h"
+#include "host.h"
+
+#include <charconv>
+#include <cstring>
+#include <vector>
+
+// Marshalled data is a tree, this only guards against corrupted input.
+#define FORMAT_MAX_DEPTH 64
+#define FORMAT_MANAGED_BUFFER_SIZE 8192
+#define FORMAT_MANAGED_BUFFER_MAX (1024 * 1024)
+
+thread_local std::string formatBuffer;
+thread_local std::vector<char> managedFormatBuffer;
+
+template<typename T>
+static void AppendInteger(std::string& out, T value)
+{
+    char buf[24];
+    auto result = std::to_chars(buf, buf + sizeof(buf), value);
+    out.append(buf, result.ptr - buf);
+}
+
+// Shortest representation that reads back to the same value, like .NET's ToString.
+template<typename T>
+static void AppendFloat(std::string& out, T value)
+{
+    char buf[32];
+    auto result = std::to_chars(buf, buf + sizeof(buf), value);
+    out.append(buf, result.ptr - buf);
+}
+
+static void AppendString(std::string& out, StringData* str, bool quoted)
+{
+    if (str == nullptr || str->ptr == nullptr) {
+        out += "(nil)";
+        return;
+    }
+
+    if (quoted) out += '"';
+    out.append((const char*)str->ptr, str->len);
+    if (quoted) out += '"';
+}
+
+// Objects only the managed side can describe. The buffer grows as long as the result fills it up.
+static void AppendManaged(std::string& out, void* value, int type)
+{
+    if (managedFormatBuffer.empty()) managedFormatBuffer.resize(FORMAT_MANAGED_BUFFER_SIZE);
+
+    while (true) {
+        memset(managedFormatBuffer.data(), 0, managedFormatBuffer.size());
+        InterpretAsString(value, type, managedFormatBuffer.data(), (int)managedFormatBuffer.size());
+
+        size_t len = strnlen(managedFormatBuffer.data(), managedFormatBuffer.size());
+        if (len + 1 < managedFormatBuffer.size() || managedFormatBuffer.size() >= FORMAT_MANAGED_BUFFER_MAX) {
+            out.append(managedFormatBuffer.data(), len);
+            return;
+        }
+
+        managedFormatBuffer.resize(managedFormatBuffer.size() * 2);
+    }
+}
+
+// Primitive elements of ArrayData / MapData are packed like a T[] (see Stack<std::vector<T>>::pushRawDotnet),
+// strings, arrays, maps and pointers are stored as pointers.
+static size_t ElementSize(int type)
+{
+    switch (type)
+    {
+    case 2:
+    case 3:
+    case 4:
+    case 5:
+        return 1;
+    case 6:
+    case 7:
+        return 2;
+    case 8:
+    case 9:
+    case 12:
+        return 4;
+    case 10:
+    case 11:
+    case 13:
+        return 8;
+    default:
+        return sizeof(void*);
+    }
+}
+
+static void* ElementAt(void** elements, int type, int index)
+{
+    return (char*)elements + ElementSize(type) * (size_t)index;
+}
+
+static void AppendValue(std::string& out, void* value, int type, int depth, bool quoted)
+{
+    switch (type)
+    {
+    case 2:
+        out += *(bool*)value ? "true" : "false";
+        break;
+    case 3:
+        AppendInteger(out, (unsigned)*(uint8_t*)value);
+        break;
+    case 4:
+        AppendInteger(out, (int)*(int8_t*)value);
+        break;
+    case 5:
+        out += *(char*)value;
+        break;
+    case 6:
+        AppendInteger(out, (int)*(short*)value);
+        break;
+    case 7:
+        AppendInteger(out, (unsigned)*(unsigned short*)value);
+        break;
+    case 8:
+        AppendInteger(out, *(int*)value);
+        break;
+    case 9:
+        AppendInteger(out, *(unsigned int*)value);
+        break;
+    case 10:
+        AppendInteger(out, *(int64_t*)value);
+        break;
+    case 11:
+        AppendInteger(out, *(uint64_t*)value);
+        break;
+    case 12:
+        AppendFloat(out, *(float*)value);
+        break;
+    case 13:
+        AppendFloat(out, *(double*)value);
+        break;
+    case 14:
+        AppendString(out, *(StringData**)value, quoted);
+        break;
+    case 15:
+    {
+        ArrayData* array = *(ArrayData**)value;
+        if (array == nullptr) {
+            out += "(nil)";
+            break;
+        }
+        if (depth >= FORMAT_MAX_DEPTH) {
+            out += "[...]";
+            break;
+        }
+
+        out += '[';
+        for (int i = 0; i < array->length; i++) {
+            if (i > 0) out += ", ";
+            AppendValue(out, ElementAt(array->elements, array->type, i), array->type, depth + 1, true);
+        }
+        out += ']';
+        break;
+    }
+    case 16:
+    {
+        MapData* map = *(MapData**)value;
+        if (map == nullptr) {
+            out += "(nil)";
+            break;
+        }
+        if (depth >= FORMAT_MAX_DEPTH) {
+            out += "{...}";
+            break;
+        }
+
+        out += '{';
+        for (int i = 0; i < map->length; i++) {
+            if (i > 0) out += ", ";
+            AppendValue(out, ElementAt(map->keys, map->key_type, i), map->key_type, depth + 1, true);
+            out += ": ";
+            AppendValue(out, ElementAt(map->values, map->value_type, i), map->value_type, depth + 1, true);
+        }
+        out += '}';
+        break;
+    }
+    default:
+        AppendManaged(out, value, type);
+        break;
+    }
+}
+
+std::string DotnetFormatValue(void* value, int type)
+{
+    formatBuffer.clear();
+    AppendValue(formatBuffer, value, type, 0, false);
+    return formatBuffer;
+}
@@ -0,0 +1,19 @@
+#ifndef _embedder_src_dotnet_format_h
+#define _embedder_src_dotnet_format_h
+
+#include <string>
+
+/**
+ * String conversion of values marshalled for the .NET bridge, used by EValue::tostring and
+ * FunctionContext::GetArgumentAsString on Dotnet contexts.
+ *
+ * `value` points at the storage of the value, like for InterpretAsString (an argument slot, the EValue pointer).
+ * Primitives (type tags 2 - 13), strings (14), arrays (15) and maps (16) are formatted natively, recursing into
+ * ArrayData / MapData, where strings are quoted: [1, 2, 3], {"key": [true, false]}.
+ * Anything else (class instances, functions) is an opaque managed object and still goes through InterpretAsString.
+ * Every thread formats into a buffer of its own, there's no length limit.
+ */
+
+std::string DotnetFormatValue(void* value, int type);
+
+#endif
@@ -2,9 +2,14 @@
 #include "dynlib.h"
 #include "strconv.h"
 #include "invoker.h"
+#include "mock_host.h"
+#include "arena.h"
 
 #include <string.h>
 #include <iostream>
+#include <atomic>
+#include <future>
+#include <mutex>
 
 hostfxr_initialize_for_runtime_config_fn _initialize_for_runtime_config = nullptr;
 hostfxr_get_runtime_delegate_fn _get_runtime_delegate = nullptr;
@@ -22,16 +27,45 @@ typedef void* (CORECLR_DELEGATE_CALLTYPE* allocate_pointer_fn)(int size, int cou
 typedef uint64_t(CORECLR_DELEGATE_CALLTYPE* get_plugin_memory_fn)(void* context);
 typedef void(CORECLR_DELEGATE_CALLTYPE* execute_function_fn)(void* ctx, void* pctx);
 typedef void(CORECLR_DELEGATE_CALLTYPE* state_fn)(int state);
-
-load_file_fn loadFile = nullptr;
-interpret_as_string_fn interpretAsString = nullptr;
-remove_file_fn removeFile = nullptr;
-allocate_pointer_fn allocatePointer = nullptr;
-get_plugin_memory_fn getMemory = nullptr;
-execute_function_fn execFunction = nullptr;
-state_fn set_state = nullptr;
+typedef void(CORECLR_DELEGATE_CALLTYPE* execute_functions_fn)(void* batch, void* pctx);
+typedef void* (CORECLR_DELEGATE_CALLTYPE* resolve_function_fn)(const char* name, int len, void* pctx);
+typedef void(CORECLR_DELEGATE_CALLTYPE* memory_pressure_fn)(void* context, int64_t delta);
+
+// A method of the managed entry point, looked up the first time it's needed. Callers on any thread (the host
+// initialization included) can get there first: the pointer is stored before `resolved` is published, so they
+// either see both or resolve it under delegateMutex themselves.
+struct DotnetDelegate
+{
+    const char_t* method;
+    // For GetDotnetPointer, when the runtime is hosted outside of this library.
+    int kind;
+    // Older managed sides don't export it, a failed lookup isn't retried.
+    bool optional;
+    std::atomic<void*> pointer{ nullptr };
+    std::atomic<bool> resolved{ false };
+};
+
+DotnetDelegate loadFile{ STR("LoadFile"), 1, false };
+DotnetDelegate interpretAsString{ STR("InterpretAsString"), 2, false };
+DotnetDelegate removeFile{ STR("RemoveFile"), 3, false };
+DotnetDelegate allocatePointer{ STR("AllocateContextPointer"), 4, false };
+DotnetDelegate getMemory{ STR("GetPluginMemoryUsage"), 5, false };
+DotnetDelegate execFunction{ STR("ExecuteFunction"), 6, false };
+DotnetDelegate set_state{ STR("UpdateGlobalStateCleanupLock"), 7, false };
+DotnetDelegate execFunctions{ STR("ExecuteFunctions"), 8, true };
+DotnetDelegate resolveFunction{ STR("ResolveFunction"), 9, true };
+DotnetDelegate memoryPressure{ STR("UpdateMemoryPressure"), 10, true };
+std::recursive_mutex delegateMutex;
 
 void* hostfxr_lib = nullptr;
+bool mockHost = false;
+
+std::recursive_mutex cleanupLockMutex;
+int cleanupLockDepth = 0;
+
+std::mutex hostInitMutex;
+std::shared_future<bool> hostInitFuture;
+thread_local bool inHostInit = false;
 
 #ifdef _WIN32
 char_t dotnet_path[1024];
@@ -96,10 +130,102 @@ bool InitializeHostFXR(std::string origin_path) {
     return true;
 }
 
+std::shared_future<bool> InitializeHostFXRAsync(std::string origin_path) {
+    std::lock_guard<std::mutex> lock(hostInitMutex);
+    if (hostInitFuture.valid()) return hostInitFuture;
+
+    hostInitFuture = std::async(std::launch::async, [origin_path]() {
+        inHostInit = true;
+        bool result = InitializeHostFXR(origin_path) && InitializeDotNetAPI();
+        inHostInit = false;
+        return result;
+    }).share();
+    return hostInitFuture;
+}
+
+static bool IsDotNetHostPending() {
+    std::lock_guard<std::mutex> lock(hostInitMutex);
+    return hostInitFuture.valid() && hostInitFuture.wait_for(std::chrono::seconds(0)) != std::future_status::ready;
+}
+
+bool WaitForDotNetHost() {
+    // The initialization itself (managed Start included) can call back into the bridge.
+    if (inHostInit) return true;
+
+    std::shared_future<bool> future;
+    {
+        std::lock_guard<std::mutex> lock(hostInitMutex);
+        future = hostInitFuture;
+    }
+
+    if (!future.valid()) return true;
+    return future.get();
+}
+
+static void SetDotnetDelegate(DotnetDelegate& delegate, void* pointer)
+{
+    delegate.pointer.store(pointer, std::memory_order_relaxed);
+    delegate.resolved.store(true, std::memory_order_release);
+}
+
+// Returns nullptr while a required delegate can't be found, the lookup is then tried again on the next call.
+static void* ResolveDotnetDelegate(DotnetDelegate& delegate)
+{
+    if (delegate.resolved.load(std::memory_order_acquire))
+        return delegate.pointer.load(std::memory_order_relaxed);
+
+    // Not under delegateMutex: the initialization thread can need a delegate before the host is ready.
+    WaitForDotNetHost();
+
+    std::lock_guard<std::recursive_mutex> lock(delegateMutex);
+    if (delegate.resolved.load(std::memory_order_acquire))
+        return delegate.pointer.load(std::memory_order_relaxed);
+
+    void* pointer = nullptr;
+    if (_load_assembly_and_get_function_pointer) {
+        int returnCode = _load_assembly_and_get_function_pointer(
+            (widenedOriginPath + WIN_LIN(L"addons\\swiftly\\bin\\managed\\SwiftlyS2.dll", "addons/swiftly/bin/managed/SwiftlyS2.dll")).c_str(),
+            STR("SwiftlyS2.Entrypoint, SwiftlyS2"), delegate.method, UNMANAGEDCALLERSONLY_METHOD, nullptr, &pointer
+        );
+
+        if (returnCode != 0) pointer = nullptr;
+    }
+    else {
+        pointer = GetDotnetPointer(delegate.kind);
+    }
+
+    if (pointer == nullptr && !delegate.optional) return nullptr;
+
+    SetDotnetDelegate(delegate, pointer);
+    return pointer;
+}
+
+bool InitializeMockDotNetAPI() {
+    mockHost = true;
+
+    SetDotnetDelegate(loadFile, GetMockDotnetPointer(1));
+    SetDotnetDelegate(interpretAsString, GetMockDotnetPointer(2));
+    SetDotnetDelegate(removeFile, GetMockDotnetPointer(3));
+    SetDotnetDelegate(allocatePointer, GetMockDotnetPointer(4));
+    SetDotnetDelegate(getMemory, GetMockDotnetPointer(5));
+    SetDotnetDelegate(execFunction, GetMockDotnetPointer(6));
+    SetDotnetDelegate(set_state, GetMockDotnetPointer(7));
+    SetDotnetDelegate(execFunctions, GetMockDotnetPointer(8));
+    SetDotnetDelegate(resolveFunction, GetMockDotnetPointer(9));
+    SetDotnetDelegate(memoryPressure, GetMockDotnetPointer(10));
+
+    return true;
+}
+
 bool InitializeDotNetAPI() {
     typedef void(CORECLR_DELEGATE_CALLTYPE* custom_loader_fn)(void* invokeNative, void* finalizer);
     static custom_loader_fn custom_loader = nullptr;
 
+    if (mockHost) return true;
+    // Dotnet contexts created while InitializeHostFXRAsync runs don't wait, it finishes the job itself.
+    if (!inHostInit && IsDotNetHostPending()) return true;
+    if (_load_assembly_and_get_function_pointer == nullptr) return false;
+
     if (custom_loader == nullptr) {
         int returnCode = _load_assembly_and_get_function_pointer(
             (widenedOriginPath + WIN_LIN(L"addons\\swiftly\\bin\\managed\\SwiftlyS2.dll", "addons/swiftly/bin/managed/SwiftlyS2.dll")).c_str(),
@@ -123,133 +249,95 @@ void CloseHostFXR() {
 
 int LoadDotnetFile(EContext* ctx, std::string filePath)
 {
-    if (loadFile == nullptr) {
-        if (_load_assembly_and_get_function_pointer) {
-            int returnCode = _load_assembly_and_get_function_pointer(
-                (widenedOriginPath + WIN_LIN(L"addons\\swiftly\\bin\\managed\\SwiftlyS2.dll", "addons/swiftly/bin/managed/SwiftlyS2.dll")).c_str(),
-                STR("SwiftlyS2.Entrypoint, SwiftlyS2"), STR("LoadFile"), UNMANAGEDCALLERSONLY_METHOD, nullptr, (void**)&loadFile
-            );
-
-            if (returnCode != 0 || loadFile == nullptr) return 1;
-        }
-        else {
-            loadFile = (load_file_fn)GetDotnetPointer(1);
-        }
-    }
+    auto fn = (load_file_fn)ResolveDotnetDelegate(loadFile);
+    if (fn == nullptr) return 1;
 
-    return loadFile(ctx, filePath.c_str(), (int)filePath.size());
+    return fn(ctx, filePath.c_str(), (int)filePath.size());
 }
 
 void InterpretAsString(void* obj, int type, const char* out, int len)
 {
-    if (interpretAsString == nullptr) {
-        if (_load_assembly_and_get_function_pointer) {
-            int returnCode = _load_assembly_and_get_function_pointer(
-                (widenedOriginPath + WIN_LIN(L"addons\\swiftly\\bin\\managed\\SwiftlyS2.dll", "addons/swiftly/bin/managed/SwiftlyS2.dll")).c_str(),
-                STR("SwiftlyS2.Entrypoint, SwiftlyS2"), STR("InterpretAsString"), UNMANAGEDCALLERSONLY_METHOD, nullptr, (void**)&interpretAsString
-            );
-
-            if (returnCode != 0 || interpretAsString == nullptr) return;
-        }
-        else {
-            interpretAsString = (interpret_as_string_fn)GetDotnetPointer(2);
-        }
-    }
+    auto fn = (interpret_as_string_fn)ResolveDotnetDelegate(interpretAsString);
+    if (fn == nullptr) return;
 
-    interpretAsString(obj, type, out, len);
+    fn(obj, type, out, len);
 }
 
 void RemoveDotnetFile(EContext* ctx)
 {
-    if (removeFile == nullptr) {
-        if (_load_assembly_and_get_function_pointer) {
-            int returnCode = _load_assembly_and_get_function_pointer(
-                (widenedOriginPath + WIN_LIN(L"addons\\swiftly\\bin\\managed\\SwiftlyS2.dll", "addons/swiftly/bin/managed/SwiftlyS2.dll")).c_str(),
-                STR("SwiftlyS2.Entrypoint, SwiftlyS2"), STR("RemoveFile"), UNMANAGEDCALLERSONLY_METHOD, nullptr, (void**)&removeFile
-            );
-
-            if (returnCode != 0 || removeFile == nullptr) return;
-        }
-        else {
-            removeFile = (remove_file_fn)GetDotnetPointer(3);
-        }
-    }
+    auto fn = (remove_file_fn)ResolveDotnetDelegate(removeFile);
+    if (fn == nullptr) return;
 
-    removeFile(ctx);
+    fn(ctx);
 }
 
 void* DotnetAllocateContextPointer(int size, int count)
 {
-    if (allocatePointer == nullptr) {
-        if (_load_assembly_and_get_function_pointer) {
-            int returnCode = _load_assembly_and_get_function_pointer(
-                (widenedOriginPath + WIN_LIN(L"addons\\swiftly\\bin\\managed\\SwiftlyS2.dll", "addons/swiftly/bin/managed/SwiftlyS2.dll")).c_str(),
-                STR("SwiftlyS2.Entrypoint, SwiftlyS2"), STR("AllocateContextPointer"), UNMANAGEDCALLERSONLY_METHOD, nullptr, (void**)&allocatePointer
-            );
-
-            if (returnCode != 0 || allocatePointer == nullptr) return nullptr;
-        }
-        else {
-            allocatePointer = (allocate_pointer_fn)GetDotnetPointer(4);
-        }
-    }
+    if (void* ptr = DotnetArenaAllocate((size_t)size * (size_t)count)) return ptr;
+
+    auto fn = (allocate_pointer_fn)ResolveDotnetDelegate(allocatePointer);
+    if (fn == nullptr) return nullptr;
 
-    return allocatePointer(size, count);
+    return fn(size, count);
 }
 
 uint64_t GetDotnetRuntimeMemoryUsage(void* context)
 {
-    if (getMemory == nullptr) {
-        if (_load_assembly_and_get_function_pointer) {
-            int returnCode = _load_assembly_and_get_function_pointer(
-                (widenedOriginPath + WIN_LIN(L"addons\\swiftly\\bin\\managed\\SwiftlyS2.dll", "addons/swiftly/bin/managed/SwiftlyS2.dll")).c_str(),
-                STR("SwiftlyS2.Entrypoint, SwiftlyS2"), STR("GetPluginMemoryUsage"), UNMANAGEDCALLERSONLY_METHOD, nullptr, (void**)&getMemory
-            );
-
-            if (returnCode != 0 || getMemory == nullptr) return 0;
-        }
-        else {
-            getMemory = (get_plugin_memory_fn)GetDotnetPointer(5);
-        }
-    }
+    auto fn = (get_plugin_memory_fn)ResolveDotnetDelegate(getMemory);
+    if (fn == nullptr) return 0;
 
-    return getMemory(context);
+    return fn(context);
 }
 
 void DotnetExecuteFunction(void* ctx, void* pctx)
 {
-    if (execFunction == nullptr) {
-        if (_load_assembly_and_get_function_pointer) {
-            int returnCode = _load_assembly_and_get_function_pointer(
-                (widenedOriginPath + WIN_LIN(L"addons\\swiftly\\bin\\managed\\SwiftlyS2.dll", "addons/swiftly/bin/managed/SwiftlyS2.dll")).c_str(),
-                STR("SwiftlyS2.Entrypoint, SwiftlyS2"), STR("ExecuteFunction"), UNMANAGEDCALLERSONLY_METHOD, nullptr, (void**)&execFunction
-            );
-
-            if (returnCode != 0 || execFunction == nullptr) return;
-        }
-        else {
-            execFunction = (execute_function_fn)GetDotnetPointer(6);
-        }
-    }
+    auto fn = (execute_function_fn)ResolveDotnetDelegate(execFunction);
+    if (fn == nullptr) return;
 
-    return execFunction(ctx, pctx);
+    return fn(ctx, pctx);
+}
+
+void* DotnetResolveFunction(const char* name, int len, void* pctx)
+{
+    auto fn = (resolve_function_fn)ResolveDotnetDelegate(resolveFunction);
+    if (fn == nullptr) return nullptr;
+
+    return fn(name, len, pctx);
+}
+
+bool DotnetExecuteFunctions(BatchCallData* batch, void* pctx)
+{
+    auto fn = (execute_functions_fn)ResolveDotnetDelegate(execFunctions);
+    if (fn == nullptr) return false;
+
+    fn(batch, pctx);
+    return true;
+}
+
+void DotnetUpdateMemoryPressure(void* context, int64_t delta)
+{
+    auto fn = (memory_pressure_fn)ResolveDotnetDelegate(memoryPressure);
+    if (fn == nullptr || delta == 0) return;
+
+    fn(context, delta);
 }
 
 void DotnetUpdateGlobalStateCleanupLock(bool state)
 {
-    if (set_state == nullptr) {
-        if (_load_assembly_and_get_function_pointer) {
-            int returnCode = _load_assembly_and_get_function_pointer(
-                (widenedOriginPath + WIN_LIN(L"addons\\swiftly\\bin\\managed\\SwiftlyS2.dll", "addons/swiftly/bin/managed/SwiftlyS2.dll")).c_str(),
-                STR("SwiftlyS2.Entrypoint, SwiftlyS2"), STR("UpdateGlobalStateCleanupLock"), UNMANAGEDCALLERSONLY_METHOD, nullptr, (void**)&set_state
-            );
-
-            if (returnCode != 0 || (void*)set_state == nullptr) return;
-        }
-        else {
-            set_state = (state_fn)GetDotnetPointer(7);
-        }
+    // Resolved before taking cleanupLockMutex, which could wait on the host initialization: natives called by
+    // managed startup, on the initialization thread, take the lock too. The setter stays under the mutex so
+    // transitions reach the managed side in the order of the depth changes.
+    auto fn = (state_fn)ResolveDotnetDelegate(set_state);
+
+    std::lock_guard<std::recursive_mutex> lock(cleanupLockMutex);
+    if (state) {
+        if (cleanupLockDepth++ > 0) return;
+    }
+    else {
+        if (cleanupLockDepth == 0 || --cleanupLockDepth > 0) return;
     }
 
-    set_state((int)state);
-}
\ No newline at end of file
+    if (fn == nullptr) return;
+
+    fn((int)state);
+}
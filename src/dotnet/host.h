@@ -4,12 +4,21 @@
 #include <nethost.h>
 #include <coreclr_delegates.h>
 #include <hostfxr.h>
+#include <future>
 #include <string>
 
 #include "../Context.h"
+#include "invoker.h"
 
 bool InitializeHostFXR(std::string origin_path);
+// Runs InitializeHostFXR and InitializeDotNetAPI on a background thread, so Lua plugins can load meanwhile.
+// Dotnet contexts can be created right away, the first call needing the runtime waits for it.
+std::shared_future<bool> InitializeHostFXRAsync(std::string origin_path);
+// Blocks until a pending InitializeHostFXRAsync is done and returns its result, true when none was started.
+bool WaitForDotNetHost();
 bool InitializeDotNetAPI();
+// Uses the native stand-in from mock_host.h instead of a .NET runtime, call it in place of InitializeHostFXR.
+bool InitializeMockDotNetAPI();
 void CloseHostFXR();
 
 int LoadDotnetFile(EContext* ctx, std::string filePath);
@@ -18,6 +27,26 @@ void InterpretAsString(void* obj, int type, const char* out, int len);
 void* DotnetAllocateContextPointer(int size, int count);
 uint64_t GetDotnetRuntimeMemoryUsage(void* context);
 void DotnetExecuteFunction(void* ctx, void* pctx);
+// Resolves a managed function name once into a handle for CallData::function_handle, valid as long as the plugin
+// is loaded. nullptr when the managed side can't resolve it, calls then go by name.
+void* DotnetResolveFunction(const char* name, int len, void* pctx);
+// Returns false when the managed side doesn't support batches, the functions then have to be called one by one.
+bool DotnetExecuteFunctions(BatchCallData* batch, void* pctx);
+// Reports native memory the plugin's objects gained (delta > 0) or released to the GC, i.e.
+// GC.AddMemoryPressure / GC.RemoveMemoryPressure on the managed side. Used by EContext::AddNativeMemory.
+void DotnetUpdateMemoryPressure(void* context, int64_t delta);
+// Nested locks are counted, the managed side is only told on the first lock and the last unlock.
 void DotnetUpdateGlobalStateCleanupLock(bool state);
 
+// Keeps the managed global state cleanup locked while alive, e.g. around a batch of EValue calls.
+class EDotnetCleanupLock
+{
+public:
+    EDotnetCleanupLock() { DotnetUpdateGlobalStateCleanupLock(true); }
+    ~EDotnetCleanupLock() { DotnetUpdateGlobalStateCleanupLock(false); }
+
+    EDotnetCleanupLock(const EDotnetCleanupLock&) = delete;
+    EDotnetCleanupLock& operator=(const EDotnetCleanupLock&) = delete;
+};
+
 #endif
\ No newline at end of file
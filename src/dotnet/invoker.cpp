@@ -2,31 +2,42 @@
 #include "../Helpers.h"
 #include "../CHelpers.h"
 
+#include <atomic>
+
 class EContext;
 class ClassData;
 
 std::map<std::type_index, int> typesMap = {
-    { typeid(void*), 1 },
-    { typeid(ClassData*), 1 },
-    { typeid(bool), 2 },
-    { typeid(uint8_t), 3 },
-    { typeid(int8_t), 4 },
-    { typeid(char), 5 },
-    { typeid(short), 6 },
-    { typeid(unsigned short), 7 },
-    { typeid(int), 8 },
-    { typeid(unsigned int), 9 },
-    { typeid(int64_t), 10 },
-    { typeid(uint64_t), 11 },
-    { typeid(float), 12 },
-    { typeid(double), 13 },
-    { typeid(std::string), 14 },
+    { typeid(void*), DotnetTypeTag<void*>::value },
+    { typeid(ClassData*), DotnetTypeTag<ClassData*>::value },
+    { typeid(bool), DotnetTypeTag<bool>::value },
+    { typeid(uint8_t), DotnetTypeTag<uint8_t>::value },
+    { typeid(int8_t), DotnetTypeTag<int8_t>::value },
+    { typeid(char), DotnetTypeTag<char>::value },
+    { typeid(short), DotnetTypeTag<short>::value },
+    { typeid(unsigned short), DotnetTypeTag<unsigned short>::value },
+    { typeid(int), DotnetTypeTag<int>::value },
+    { typeid(unsigned int), DotnetTypeTag<unsigned int>::value },
+    { typeid(int64_t), DotnetTypeTag<int64_t>::value },
+    { typeid(uint64_t), DotnetTypeTag<uint64_t>::value },
+    { typeid(float), DotnetTypeTag<float>::value },
+    { typeid(double), DotnetTypeTag<double>::value },
+    { typeid(std::string), DotnetTypeTag<std::string>::value },
 };
 
 void DotNetFunctionCallback(EContext* ctx, CallContext& call_ctx);
 void DotNetMemberCallback(EContext* ctx, CallContext& call_ctx);
 void DotnetClassCallback(EContext* ctx, CallContext& call_ctx, bool bypassClassCheck = false);
 
+// Replies with the DotnetDirectNative of a native or class function, or nullptr when it's only reachable through the generic bridge.
+static void DotnetResolveNative(EContext* ctx, CallContext& call_ctx, bool classFunction)
+{
+    std::string key = call_ctx.GetNamespace() + " " + call_ctx.GetFunction();
+    DotnetDirectNative* direct = classFunction ? ctx->GetClassFunctionDotnetDirect(key) : ctx->GetFunctionDotnetDirect(key);
+    call_ctx.SetReturnType(DotnetTypeTag<void*>::value);
+    call_ctx.SetResult((void*)direct);
+}
+
 void Dotnet_InvokeNative(CallData& context)
 {
     CallContext ctx(context);
@@ -34,11 +45,84 @@ void Dotnet_InvokeNative(CallData& context)
     else if (context.call_kind == (int)CallKind::ClassFunction) return DotnetClassCallback(ctx.GetArgument<EContext*>(0), ctx, true);
     else if (context.call_kind == (int)CallKind::CoreClassFunction) return DotnetClassCallback(ctx.GetArgument<EContext*>(0), ctx, true);
     else if (context.call_kind == (int)CallKind::ClassMember) return DotNetMemberCallback(ctx.GetArgument<EContext*>(0), ctx);
+    else if (context.call_kind == (int)CallKind::ResolveNative) return DotnetResolveNative(ctx.GetArgument<EContext*>(0), ctx, false);
+    else if (context.call_kind == (int)CallKind::ResolveClassNative) return DotnetResolveNative(ctx.GetArgument<EContext*>(0), ctx, true);
 }
 
-std::set<void*> droppedValues;
+// Finalizations reported by the CLR, pushed from its finalizer thread and drained by the thread owning the contexts.
+// Producers only prepend with a CAS, the consumer takes the whole list at once, so there's no ABA to care about.
+struct DotnetFinalization
+{
+    EContext* ctx;
+    ClassData* data;
+    DotnetFinalization* next;
+};
+
+std::atomic<DotnetFinalization*> pendingFinalizations{ nullptr };
+std::atomic<size_t> pendingFinalizationsCount{ 0 };
+
+// Entries a drain for one context left for the others, oldest first. Only touched by the draining thread.
+DotnetFinalization* deferredFinalizations = nullptr;
+DotnetFinalization* deferredFinalizationsLast = nullptr;
 
 void Dotnet_ClassDataFinalizer(void* plugin_context, void* instance)
 {
-    CHelpers::DotNetGCFunction((EContext*)plugin_context, (ClassData*)instance, &droppedValues);
+    if (!instance) return;
+
+    DotnetFinalization* entry = new DotnetFinalization{ (EContext*)plugin_context, (ClassData*)instance, nullptr };
+    pendingFinalizationsCount.fetch_add(1, std::memory_order_relaxed);
+
+    DotnetFinalization* head = pendingFinalizations.load(std::memory_order_relaxed);
+    do {
+        entry->next = head;
+    } while (!pendingFinalizations.compare_exchange_weak(head, entry, std::memory_order_release, std::memory_order_relaxed));
+}
+
+size_t DrainDotnetFinalizers(EContext* ctx)
+{
+    DotnetFinalization* list = pendingFinalizations.exchange(nullptr, std::memory_order_acquire);
+
+    // The list is newest first, reverse it so objects are destroyed in the order they were finalized,
+    // after the ones an earlier drain left for other contexts.
+    DotnetFinalization* ordered = nullptr;
+    while (list) {
+        DotnetFinalization* next = list->next;
+        list->next = ordered;
+        ordered = list;
+        list = next;
+    }
+
+    if (deferredFinalizationsLast) {
+        deferredFinalizationsLast->next = ordered;
+        ordered = deferredFinalizations;
+    }
+    deferredFinalizations = nullptr;
+    deferredFinalizationsLast = nullptr;
+
+    size_t processed = 0;
+
+    while (ordered) {
+        DotnetFinalization* entry = ordered;
+        ordered = entry->next;
+
+        if (ctx && entry->ctx != ctx) {
+            entry->next = nullptr;
+            if (deferredFinalizationsLast) deferredFinalizationsLast->next = entry;
+            else deferredFinalizations = entry;
+            deferredFinalizationsLast = entry;
+            continue;
+        }
+
+        CHelpers::DotNetGCFunction(entry->ctx, entry->data);
+        delete entry;
+        processed++;
+    }
+
+    pendingFinalizationsCount.fetch_sub(processed, std::memory_order_relaxed);
+    return processed;
+}
+
+size_t GetPendingDotnetFinalizers()
+{
+    return pendingFinalizationsCount.load(std::memory_order_relaxed);
 }
\ No newline at end of file
@@ -36,8 +36,44 @@
 #include <typeinfo>
 #include <map>
 
+class ClassData;
+class EContext;
+
 void* DotnetAllocateContextPointer(int size, int count);
 
+// Type IDs shared with the managed side, resolved at compile time. Types without an ID are 0.
+template<typename T>
+struct DotnetTypeTag
+{
+    static constexpr int value = 0;
+};
+
+#define DOTNET_TYPE_TAG(type, tag)                 \
+    template<>                                     \
+    struct DotnetTypeTag<type>                     \
+    {                                              \
+        static constexpr int value = tag;          \
+    };
+
+DOTNET_TYPE_TAG(void*, 1)
+DOTNET_TYPE_TAG(ClassData*, 1)
+DOTNET_TYPE_TAG(bool, 2)
+DOTNET_TYPE_TAG(uint8_t, 3)
+DOTNET_TYPE_TAG(int8_t, 4)
+DOTNET_TYPE_TAG(char, 5)
+DOTNET_TYPE_TAG(short, 6)
+DOTNET_TYPE_TAG(unsigned short, 7)
+DOTNET_TYPE_TAG(int, 8)
+DOTNET_TYPE_TAG(unsigned int, 9)
+DOTNET_TYPE_TAG(int64_t, 10)
+DOTNET_TYPE_TAG(uint64_t, 11)
+DOTNET_TYPE_TAG(float, 12)
+DOTNET_TYPE_TAG(double, 13)
+DOTNET_TYPE_TAG(std::string, 14)
+
+#undef DOTNET_TYPE_TAG
+
+// Runtime lookup of the same IDs, for reflection and debugging. The marshalling code uses DotnetTypeTag.
 extern std::map<std::type_index, int> typesMap;
 
 enum class CallKind
@@ -46,7 +82,25 @@ enum class CallKind
     Function,
     ClassMember,
     ClassFunction,
-    CoreClassFunction
+    CoreClassFunction,
+    // Ask for the DotnetDirectNative of a native (see Bind<Func>::DotnetDirectCall) or of a class function
+    // (see BindMethod<Func>), returned as a pointer, nullptr when it's only reachable through the generic bridge.
+    ResolveNative,
+    ResolveClassNative
+};
+
+// A native callable through a `delegate* unmanaged`. The managed side calls `entry` with the record itself as
+// first argument, which is how the entry point knows its context and the name it was registered under.
+// Records are owned by their context and keep their address as long as it lives. Registering the key again
+// retires the record: it stops being resolved, and calls through it go to the current registration via the bridge.
+struct DotnetDirectNative
+{
+    void* entry;
+    EContext* ctx;
+    std::string namespace_path;
+    std::string function_name;
+    std::string key;
+    bool retired = false;
 };
 
 struct MapData
@@ -92,6 +146,27 @@ struct CallData
     int dbginfo_len;
 
     int call_kind;
+
+    // Handle from DotnetResolveFunction, when set the managed side doesn't have to look function_str up.
+    void* function_handle;
+};
+
+// Several managed functions called with the same arguments in a single transition (see DotnetExecuteFunctions).
+// Every output array has `count` entries, errors[i].ptr stays nullptr unless function i threw.
+struct BatchCallData
+{
+    CallData* call;
+    const char** functions;
+    int* function_lens;
+    int count;
+
+    uint64_t* return_values;
+    int* return_types;
+    int* has_return;
+    StringData* errors;
+
+    // Entries can be nullptr, those functions are looked up by name.
+    void** function_handles;
 };
 
 class CallContext
@@ -274,6 +349,13 @@ public:
 };
 
 void Dotnet_InvokeNative(CallData& context);
+// Called by the CLR from its finalizer thread, only queues the ClassData for DrainDotnetFinalizers.
 void Dotnet_ClassDataFinalizer(void* plugin_context, void* instance);
 
+// Destroys the ClassData finalized by managed code since the last drain, running their destructor callbacks.
+// Has to be called from the thread owning the contexts (e.g. once per tick). nullptr drains every context.
+// Returns how many finalizations were processed.
+size_t DrainDotnetFinalizers(EContext* ctx = nullptr);
+size_t GetPendingDotnetFinalizers();
+
 #endif
\ No newline at end of file
@@ -0,0 +1,303 @@
+#include "mock_host.h"
+
+#include <coreclr_delegates.h>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <map>
+#include <vector>
+
+std::map<std::string, MockManagedFunction> mockFunctions;
+MockManagedFileLoader mockFileLoader = nullptr;
+
+uint64_t mockTransitions = 0;
+int64_t mockMemoryPressure = 0;
+
+//////////////////////////////////////////////////////////////
+/////////////////       Context Pointers       //////////////
+////////////////////////////////////////////////////////////
+
+// Bump allocated blocks, everything handed out stays valid until ResetMockDotnetAllocations.
+#define MOCK_BLOCK_SIZE (64 * 1024)
+
+struct MockBlock
+{
+    char* data;
+    size_t size;
+    size_t used;
+};
+
+std::vector<MockBlock> mockBlocks;
+uint64_t mockAllocatedBytes = 0;
+
+static void* MockAllocate(size_t bytes)
+{
+    bytes = (bytes + 7) & ~(size_t)7;
+    if (bytes == 0) bytes = 8;
+
+    if (mockBlocks.empty() || mockBlocks.back().size - mockBlocks.back().used < bytes)
+    {
+        size_t size = bytes > MOCK_BLOCK_SIZE ? bytes : MOCK_BLOCK_SIZE;
+        mockBlocks.push_back({ (char*)malloc(size), size, 0 });
+    }
+
+    MockBlock& block = mockBlocks.back();
+    void* ptr = block.data + block.used;
+    block.used += bytes;
+    mockAllocatedBytes += bytes;
+
+    memset(ptr, 0, bytes);
+    return ptr;
+}
+
+void ResetMockDotnetAllocations()
+{
+    for (auto& block : mockBlocks)
+        free(block.data);
+
+    mockBlocks.clear();
+    mockAllocatedBytes = 0;
+}
+
+uint64_t GetMockDotnetAllocatedBytes()
+{
+    return mockAllocatedBytes;
+}
+
+uint64_t GetMockDotnetTransitions()
+{
+    return mockTransitions;
+}
+
+int64_t GetMockDotnetMemoryPressure()
+{
+    return mockMemoryPressure;
+}
+
+//////////////////////////////////////////////////////////////
+/////////////////       Mock Delegates         //////////////
+////////////////////////////////////////////////////////////
+
+static int CORECLR_DELEGATE_CALLTYPE MockLoadFile(void* context, const char* filePath, int len)
+{
+    mockTransitions++;
+    if (!mockFileLoader) return 0;
+
+    return mockFileLoader((EContext*)context, std::string(filePath, len));
+}
+
+static void CORECLR_DELEGATE_CALLTYPE MockInterpretAsString(void* object, int type, const char* out, int len)
+{
+    mockTransitions++;
+
+    char* buf = const_cast<char*>(out);
+    void* ptr = *(void**)object;
+
+    switch (type)
+    {
+    case 2:
+        snprintf(buf, len, "%s", *(bool*)object ? "true" : "false");
+        break;
+    case 3:
+        snprintf(buf, len, "%u", (unsigned)*(uint8_t*)object);
+        break;
+    case 4:
+        snprintf(buf, len, "%d", (int)*(int8_t*)object);
+        break;
+    case 5:
+        snprintf(buf, len, "%c", *(char*)object);
+        break;
+    case 6:
+        snprintf(buf, len, "%d", (int)*(short*)object);
+        break;
+    case 7:
+        snprintf(buf, len, "%u", (unsigned)*(unsigned short*)object);
+        break;
+    case 8:
+        snprintf(buf, len, "%d", *(int*)object);
+        break;
+    case 9:
+        snprintf(buf, len, "%u", *(unsigned int*)object);
+        break;
+    case 10:
+        snprintf(buf, len, "%" PRId64, *(int64_t*)object);
+        break;
+    case 11:
+        snprintf(buf, len, "%" PRIu64, *(uint64_t*)object);
+        break;
+    case 12:
+        snprintf(buf, len, "%g", (double)*(float*)object);
+        break;
+    case 13:
+        snprintf(buf, len, "%g", *(double*)object);
+        break;
+    case 14:
+    {
+        StringData* str = (StringData*)ptr;
+        if (str == nullptr || str->ptr == nullptr) snprintf(buf, len, "(nil)");
+        else snprintf(buf, len, "%.*s", str->len, (const char*)str->ptr);
+        break;
+    }
+    case 15:
+        snprintf(buf, len, "array: %p", ptr);
+        break;
+    case 16:
+        snprintf(buf, len, "map: %p", ptr);
+        break;
+    case 17:
+        snprintf(buf, len, "function: %s", ptr ? (const char*)ptr : "(nil)");
+        break;
+    default:
+        snprintf(buf, len, "object: %p", ptr);
+        break;
+    }
+}
+
+static void CORECLR_DELEGATE_CALLTYPE MockRemoveFile(void* context)
+{
+    mockTransitions++;
+}
+
+static void* CORECLR_DELEGATE_CALLTYPE MockAllocateContextPointer(int size, int count)
+{
+    mockTransitions++;
+    return MockAllocate((size_t)size * (size_t)count);
+}
+
+static uint64_t CORECLR_DELEGATE_CALLTYPE MockGetPluginMemoryUsage(void* context)
+{
+    mockTransitions++;
+    return mockAllocatedBytes;
+}
+
+static void CORECLR_DELEGATE_CALLTYPE MockExecuteFunction(void* ctx, void* pctx)
+{
+    mockTransitions++;
+
+    CallData* data = (CallData*)ctx;
+    MockManagedFunction func = nullptr;
+    if (data->function_handle) func = *(MockManagedFunction*)data->function_handle;
+    else if (data->function_str) {
+        auto it = mockFunctions.find(std::string(data->function_str, data->function_len));
+        if (it != mockFunctions.end()) func = it->second;
+    }
+    if (func == nullptr) return;
+
+    CallContext call_ctx(*data);
+    func((EContext*)pctx, call_ctx);
+}
+
+// Handles point at the registered entry, which std::map keeps in place.
+static void* CORECLR_DELEGATE_CALLTYPE MockResolveFunction(const char* name, int len, void* pctx)
+{
+    mockTransitions++;
+
+    auto it = mockFunctions.find(std::string(name, len));
+    if (it == mockFunctions.end()) return nullptr;
+    return &it->second;
+}
+
+// A managed function throwing a C++ exception stands for a .NET exception, reported through the batch errors.
+static void CORECLR_DELEGATE_CALLTYPE MockExecuteFunctions(void* batch_ptr, void* pctx)
+{
+    mockTransitions++;
+
+    BatchCallData* batch = (BatchCallData*)batch_ptr;
+    for (int i = 0; i < batch->count; i++)
+    {
+        batch->has_return[i] = 0;
+        batch->errors[i] = { nullptr, 0 };
+
+        MockManagedFunction func = nullptr;
+        if (batch->function_handles && batch->function_handles[i]) func = *(MockManagedFunction*)batch->function_handles[i];
+        else {
+            auto it = mockFunctions.find(std::string(batch->functions[i], batch->function_lens[i]));
+            if (it != mockFunctions.end()) func = it->second;
+        }
+        if (func == nullptr) continue;
+
+        // Every function gets its own copy of the arguments, like the managed side unmarshalling them again.
+        CallData data = *batch->call;
+        data.function_str = batch->functions[i];
+        data.function_len = batch->function_lens[i];
+        data.function_handle = batch->function_handles ? batch->function_handles[i] : nullptr;
+        data.has_return = 0;
+
+        CallContext call_ctx(data);
+        try {
+            func((EContext*)pctx, call_ctx);
+        }
+        catch (std::exception& e) {
+            size_t len = strlen(e.what());
+            char* message = (char*)MockAllocate(len + 1);
+            memcpy(message, e.what(), len + 1);
+            batch->errors[i] = { message, (int)len };
+            continue;
+        }
+
+        batch->return_values[i] = data.return_value;
+        batch->return_types[i] = data.return_type;
+        batch->has_return[i] = data.has_return;
+    }
+}
+
+static void CORECLR_DELEGATE_CALLTYPE MockUpdateMemoryPressure(void* context, int64_t delta)
+{
+    mockTransitions++;
+    mockMemoryPressure += delta;
+}
+
+static void CORECLR_DELEGATE_CALLTYPE MockUpdateGlobalStateCleanupLock(int state)
+{
+    mockTransitions++;
+}
+
+void* GetMockDotnetPointer(int kind)
+{
+    switch (kind)
+    {
+    case 1: return reinterpret_cast<void*>(MockLoadFile);
+    case 2: return reinterpret_cast<void*>(MockInterpretAsString);
+    case 3: return reinterpret_cast<void*>(MockRemoveFile);
+    case 4: return reinterpret_cast<void*>(MockAllocateContextPointer);
+    case 5: return reinterpret_cast<void*>(MockGetPluginMemoryUsage);
+    case 6: return reinterpret_cast<void*>(MockExecuteFunction);
+    case 7: return reinterpret_cast<void*>(MockUpdateGlobalStateCleanupLock);
+    case 8: return reinterpret_cast<void*>(MockExecuteFunctions);
+    case 9: return reinterpret_cast<void*>(MockResolveFunction);
+    case 10: return reinterpret_cast<void*>(MockUpdateMemoryPressure);
+    default: return nullptr;
+    }
+}
+
+//////////////////////////////////////////////////////////////
+/////////////////      Managed Functions       //////////////
+////////////////////////////////////////////////////////////
+
+void RegisterMockManagedFunction(std::string name, MockManagedFunction func)
+{
+    mockFunctions.insert_or_assign(name, func);
+}
+
+void SetMockManagedFileLoader(MockManagedFileLoader loader)
+{
+    mockFileLoader = loader;
+}
+
+void PrepareMockNativeCall(CallData& data, EContext* ctx, CallKind kind, const std::string& namespace_path, const std::string& function_name)
+{
+    memset(&data, 0, sizeof(CallData));
+
+    data.namespace_str = namespace_path.c_str();
+    data.namespace_len = (int)namespace_path.size();
+    data.function_str = function_name.c_str();
+    data.function_len = (int)function_name.size();
+    data.call_kind = (int)kind;
+
+    // The plugin context always travels as the first argument.
+    data.args_count = 1;
+    data.args_data[0] = (uint64_t)(uintptr_t)ctx;
+    data.args_type[0] = 1;
+}
@@ -0,0 +1,43 @@
+#ifndef _embedder_src_dotnet_mock_host_h
+#define _embedder_src_dotnet_mock_host_h
+
+/**
+ * Native stand-in for the managed side of the .NET bridge.
+ * Selected with InitializeMockDotNetAPI() (host.h) instead of InitializeHostFXR(), it implements every delegate
+ * the bridge resolves (LoadFile, ExecuteFunction, AllocateContextPointer, ...) in C++, so the native half
+ * (Dotnet_InvokeNative, CallContext marshalling, Stack<T> raw conversions) can be exercised without CoreCLR.
+ *
+ * Like the managed side, it's meant to be driven from a single thread.
+ */
+
+#include <cstdint>
+#include <string>
+
+#include "invoker.h"
+
+class EContext;
+
+// A "managed" function callable through EValue::operator() on a Dotnet context, looked up by name.
+typedef void (*MockManagedFunction)(EContext* ctx, CallContext& call_ctx);
+typedef int (*MockManagedFileLoader)(EContext* ctx, std::string filePath);
+
+void* GetMockDotnetPointer(int kind);
+
+void RegisterMockManagedFunction(std::string name, MockManagedFunction func);
+void SetMockManagedFileLoader(MockManagedFileLoader loader);
+
+// Prepares `data` the way the managed side does before calling into Dotnet_InvokeNative.
+// `namespace_path` and `function_name` have to outlive the call.
+void PrepareMockNativeCall(CallData& data, EContext* ctx, CallKind kind, const std::string& namespace_path, const std::string& function_name);
+
+// AllocateContextPointer memory is owned by the mock until it's reset.
+void ResetMockDotnetAllocations();
+uint64_t GetMockDotnetAllocatedBytes();
+
+// Number of calls made into the mock delegates, i.e. native -> managed transitions.
+uint64_t GetMockDotnetTransitions();
+
+// Sum of the memory pressure reported through UpdateMemoryPressure.
+int64_t GetMockDotnetMemoryPressure();
+
+#endif
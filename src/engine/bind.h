@@ -0,0 +1,240 @@
+#ifndef _embedder_engine_bind_h
+#define _embedder_engine_bind_h
+
+#include "functions.h"
+#include "../NativeProfiler.h"
+
+#include <coreclr_delegates.h>
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+int LuaFunctionCallback(lua_State* L);
+void DotNetFunctionCallback(EContext* ctx, CallContext& call_ctx);
+void DotnetClassCallback(EContext* ctx, CallContext& call_ctx, bool bypassClassCheck);
+
+// Types passed as they are through an unmanaged call: numbers, bool (a single byte) and pointers.
+template <typename T>
+struct is_dotnet_direct : std::bool_constant<DotnetTypeTag<T>::value != 0 && DotnetTypeTag<T>::value != DotnetTypeTag<std::string>::value> {};
+
+//////////////////////////////////////////////////////////////
+/////////////////   Typed Function Bindings    //////////////
+////////////////////////////////////////////////////////////
+
+// Bind<&Func> turns a plain C++ function into natives with the arguments read and the result pushed
+// through Stack<T> directly. The FunctionContext path (Call) is only taken while the context has hooks.
+template <auto Func>
+struct Bind;
+
+template <typename R, typename... Args, R (*Func)(Args...)>
+struct Bind<Func>
+{
+    static void Call(FunctionContext* context)
+    {
+        Invoke(context, std::index_sequence_for<Args...>{});
+    }
+
+    static int LuaCall(lua_State* L)
+    {
+        auto ctx = GetContextByState(L);
+        if (ctx->HasFunctionHooks()) return LuaFunctionCallback(L);
+        EActiveStateScope active(ctx, L);
+
+        NativeProfilerScope profile(NativeProfilerKind::Function, IsNativeProfilerEnabled() ? lua_tostring(L, lua_upvalueindex(1)) : nullptr);
+        return LuaInvoke(ctx, std::index_sequence_for<Args...>{});
+    }
+
+    static void DotnetCall(EContext* ctx, CallContext& call_ctx)
+    {
+        DotnetInvoke(ctx, call_ctx, std::index_sequence_for<Args...>{});
+    }
+
+    static constexpr bool DotnetDirectSupported = (std::is_void<R>::value || is_dotnet_direct<std::decay_t<R>>::value) && (is_dotnet_direct<std::decay_t<Args>>::value && ...);
+
+    // Typed entry point for a `delegate* unmanaged` on the managed side, resolved through CallKind::ResolveNative,
+    // so calls don't build a CallData. Hooks still run: while the context has any, the call goes through the bridge.
+    static std::decay_t<R> CORECLR_DELEGATE_CALLTYPE DotnetDirectCall(DotnetDirectNative* native, std::decay_t<Args>... args)
+    {
+        if (native->retired || native->ctx->HasFunctionHooks()) return DotnetDirectFallback(native, args...);
+
+        NativeProfilerScope profile(NativeProfilerKind::Function, IsNativeProfilerEnabled() ? native->key.c_str() : nullptr);
+        return Func(args...);
+    }
+
+private:
+    static std::decay_t<R> DotnetDirectFallback(DotnetDirectNative* native, std::decay_t<Args>... args)
+    {
+        EContext* ctx = native->ctx;
+
+        CallData data;
+        memset(&data, 0, sizeof(CallData));
+        data.namespace_str = native->namespace_path.c_str();
+        data.namespace_len = (int)native->namespace_path.size();
+        data.function_str = native->function_name.c_str();
+        data.function_len = (int)native->function_name.size();
+        data.call_kind = (int)CallKind::Function;
+
+        CallContext call_ctx(data);
+        call_ctx.SetArgumentType(0, DotnetTypeTag<void*>::value);
+        call_ctx.PushArgument((void*)ctx);
+        {
+            EDotnetArenaMarshalScope marshal;
+            (Stack<std::decay_t<Args>>::pushDotnet(ctx, &call_ctx, args), ...);
+        }
+
+        DotNetFunctionCallback(ctx, call_ctx);
+
+        if constexpr (!std::is_void<R>::value) {
+            if (!call_ctx.HasReturn()) return std::decay_t<R>{};
+            return Stack<std::decay_t<R>>::getDotnet(ctx, &call_ctx, -1);
+        }
+    }
+
+    template <size_t... I>
+    static void Invoke(FunctionContext* context, std::index_sequence<I...>)
+    {
+        if constexpr (std::is_void<R>::value) {
+            Func(context->GetArgument<std::decay_t<Args>>((int)I)...);
+        }
+        else {
+            context->SetReturn<std::decay_t<R>>(Func(context->GetArgument<std::decay_t<Args>>((int)I)...));
+        }
+    }
+
+    template <size_t... I>
+    static int LuaInvoke(EContext* ctx, std::index_sequence<I...>)
+    {
+        if constexpr (std::is_void<R>::value) {
+            Func(Stack<std::decay_t<Args>>::getLua(ctx, (int)I + 1)...);
+            return 0;
+        }
+        else {
+            std::decay_t<R> result = Func(Stack<std::decay_t<Args>>::getLua(ctx, (int)I + 1)...);
+            Stack<std::decay_t<R>>::pushLua(ctx, result);
+            return 1;
+        }
+    }
+
+    // Argument 0 is the plugin context pointer.
+    template <size_t... I>
+    static void DotnetInvoke(EContext* ctx, CallContext& call_ctx, std::index_sequence<I...>)
+    {
+        if constexpr (std::is_void<R>::value) {
+            Func(Stack<std::decay_t<Args>>::getDotnet(ctx, &call_ctx, (int)I + 1)...);
+        }
+        else {
+            std::decay_t<R> result = Func(Stack<std::decay_t<Args>>::getDotnet(ctx, &call_ctx, (int)I + 1)...);
+            EDotnetArenaMarshalScope marshal;
+            Stack<std::decay_t<R>>::pushDotnet(ctx, &call_ctx, result, true);
+        }
+    }
+};
+
+#define ADD_BINDING(function_name, func) \
+    AddScriptingBinding<func>(ctx, "_G", function_name)
+#define ADD_BINDING_CTX(ctx, function_name, func) \
+    AddScriptingBinding<func>(ctx, "_G", function_name)
+#define ADD_BINDING_NS(ns_path, function_name, func) \
+    AddScriptingBinding<func>(ctx, ns_path, function_name)
+#define ADD_BINDING_NS_CTX(ctx, ns_path, function_name, func) \
+    AddScriptingBinding<func>(ctx, ns_path, function_name)
+
+template <auto Func>
+void AddScriptingBinding(EContext* ctx, std::string namespace_path, std::string function_name)
+{
+    AddScriptingFunction(ctx, namespace_path, function_name, Bind<Func>::Call, Bind<Func>::LuaCall);
+    ctx->AddFunctionDotnetThunk(namespace_path + " " + function_name, reinterpret_cast<void*>(Bind<Func>::DotnetCall));
+
+    if constexpr (Bind<Func>::DotnetDirectSupported)
+        ctx->AddFunctionDotnetDirect(namespace_path, function_name, reinterpret_cast<void*>(Bind<Func>::DotnetDirectCall));
+}
+
+//////////////////////////////////////////////////////////////
+/////////////////    Typed Method Bindings     //////////////
+////////////////////////////////////////////////////////////
+
+// BindMethod<&Func> does the same for class functions, written as `R Func(ClassData* self, Args...)`.
+// Lua and the generic .NET bridge call it as a regular class function, with the hooks and the profiler,
+// and .NET can also resolve a typed entry point through CallKind::ResolveClassNative.
+template <auto Func>
+struct BindMethod;
+
+template <typename R, typename... Args, R (*Func)(ClassData*, Args...)>
+struct BindMethod<Func>
+{
+    static void Call(FunctionContext* context, ClassData* data)
+    {
+        Invoke(context, data, std::index_sequence_for<Args...>{});
+    }
+
+    static constexpr bool DotnetDirectSupported = (std::is_void<R>::value || is_dotnet_direct<std::decay_t<R>>::value) && (is_dotnet_direct<std::decay_t<Args>>::value && ...);
+
+    static std::decay_t<R> CORECLR_DELEGATE_CALLTYPE DotnetDirectCall(DotnetDirectNative* native, ClassData* data, std::decay_t<Args>... args)
+    {
+        if (native->retired || native->ctx->HasClassFunctionHooks()) return DotnetDirectFallback(native, data, args...);
+
+        NativeProfilerScope profile(NativeProfilerKind::ClassFunction, IsNativeProfilerEnabled() ? native->key.c_str() : nullptr);
+        return Func(data, args...);
+    }
+
+private:
+    // Argument 0 is the plugin context pointer and argument 1 the instance, like a call from the managed side.
+    static std::decay_t<R> DotnetDirectFallback(DotnetDirectNative* native, ClassData* data, std::decay_t<Args>... args)
+    {
+        EContext* ctx = native->ctx;
+
+        CallData call;
+        memset(&call, 0, sizeof(CallData));
+        call.namespace_str = native->namespace_path.c_str();
+        call.namespace_len = (int)native->namespace_path.size();
+        call.function_str = native->function_name.c_str();
+        call.function_len = (int)native->function_name.size();
+        call.call_kind = (int)CallKind::ClassFunction;
+
+        CallContext call_ctx(call);
+        call_ctx.SetArgumentType(0, DotnetTypeTag<void*>::value);
+        call_ctx.PushArgument((void*)ctx);
+        call_ctx.SetArgumentType(1, DotnetTypeTag<ClassData*>::value);
+        call_ctx.PushArgument((void*)data);
+        {
+            EDotnetArenaMarshalScope marshal;
+            (Stack<std::decay_t<Args>>::pushDotnet(ctx, &call_ctx, args), ...);
+        }
+
+        DotnetClassCallback(ctx, call_ctx, true);
+
+        if constexpr (!std::is_void<R>::value) {
+            if (!call_ctx.HasReturn()) return std::decay_t<R>{};
+            return Stack<std::decay_t<R>>::getDotnet(ctx, &call_ctx, -1);
+        }
+    }
+
+    template <size_t... I>
+    static void Invoke(FunctionContext* context, ClassData* data, std::index_sequence<I...>)
+    {
+        if constexpr (std::is_void<R>::value) {
+            Func(data, context->GetArgument<std::decay_t<Args>>((int)I)...);
+        }
+        else {
+            context->SetReturn<std::decay_t<R>>(Func(data, context->GetArgument<std::decay_t<Args>>((int)I)...));
+        }
+    }
+};
+
+#define ADD_CLASS_BINDING(class_name, function_name, func) \
+    AddScriptingClassBinding<func>(ctx, class_name, function_name)
+#define ADD_CLASS_BINDING_CTX(ctx, class_name, function_name, func) \
+    AddScriptingClassBinding<func>(ctx, class_name, function_name)
+
+// Not meant for constructors, which create their instance instead of receiving it.
+template <auto Func>
+void AddScriptingClassBinding(EContext* ctx, std::string class_name, std::string function_name)
+{
+    AddScriptingClassFunction(ctx, class_name, function_name, BindMethod<Func>::Call);
+
+    if constexpr (BindMethod<Func>::DotnetDirectSupported)
+        ctx->AddClassFunctionDotnetDirect(class_name, function_name, reinterpret_cast<void*>(BindMethod<Func>::DotnetDirectCall));
+}
+
+#endif
@@ -10,10 +10,22 @@ ClassData::ClassData(std::map<std::string, std::any> data, std::string className
     m_ctx = ctx;
 }
 
+ClassData::ClassData(const ClassData& other)
+{
+    m_classData = other.m_classData;
+    m_className = other.m_className;
+    m_ctx = other.m_ctx;
+    m_nativeSize = other.m_nativeSize;
+
+    if (m_ctx && m_nativeSize) m_ctx->AddNativeMemory((int64_t)m_nativeSize);
+}
+
 ClassData::~ClassData()
 {
+    if (m_ctx && m_nativeSize) m_ctx->AddNativeMemory(-(int64_t)m_nativeSize);
+
     std::vector<ClassData**> udatas = GetDataOr<std::vector<ClassData**>>("lua_udatas", std::vector<ClassData**>{});
-    for (int i = 0; i < udatas.size(); i++) {
+    for (size_t i = 0; i < udatas.size(); i++) {
         ClassData** udata = udatas[i];
         (*udata) = nullptr;
     }
@@ -27,7 +39,6 @@ ClassData::~ClassData()
     FunctionContext fctx(str_key, m_ctx->GetKind(), m_ctx, nullptr);
     FunctionContext* fptr = &fctx;
     ClassData* data = this;
-    bool ignoreCustomReturn = false;
 
     auto functionPreCalls = m_ctx->GetClassFunctionPreCalls(str_key);
     auto functionPostCalls = m_ctx->GetClassFunctionPostCalls(str_key);
@@ -54,6 +65,27 @@ ClassData::~ClassData()
     }
 }
 
+void ClassData::SetNativeSize(size_t bytes)
+{
+    if (m_ctx) m_ctx->AddNativeMemory((int64_t)bytes - (int64_t)m_nativeSize);
+    m_nativeSize = bytes;
+}
+
+size_t ClassData::GetNativeSize()
+{
+    return m_nativeSize;
+}
+
+EContext* ClassData::GetContext()
+{
+    return m_ctx;
+}
+
+void ClassData::DetachContext()
+{
+    m_ctx = nullptr;
+}
+
 void ClassData::SetData(std::string key, std::any value)
 {
     m_classData[key] = value;
@@ -8,6 +8,7 @@
 int LuaMemberCallbackIndex(lua_State* L, std::string str_key)
 {
     auto ctx = GetContextByState(L);
+    NativeProfilerScope profile(NativeProfilerKind::MemberGet, str_key);
 
     FunctionContext fctx(str_key, ctx->GetKind(), ctx, true, false, true);
     FunctionContext* fptr = &fctx;
@@ -20,6 +21,7 @@ int LuaMemberCallbackIndex(lua_State* L, std::string str_key)
     auto functionPostCalls = ctx->GetClassMemberPostCalls(str_key);
     bool stopExecution = false;
 
+    profile.HooksBegin();
     for (auto func : functionPreCalls)
     {
         reinterpret_cast<ScriptingClassFunctionCallback>(func.first)(fptr, data);
@@ -29,6 +31,7 @@ int LuaMemberCallbackIndex(lua_State* L, std::string str_key)
             break;
         }
     }
+    profile.HooksEnd();
 
     if (!stopExecution) {
         void* func = ctx->GetClassMemberCalls(str_key).first;
@@ -37,11 +40,13 @@ int LuaMemberCallbackIndex(lua_State* L, std::string str_key)
             cb(fptr, data);
         }
 
+        profile.HooksBegin();
         for (auto func : functionPostCalls)
         {
             reinterpret_cast<ScriptingClassFunctionCallback>(func.first)(fptr, data);
             if (fctx.ShouldStopExecution()) break;
         }
+        profile.HooksEnd();
     }
 
     int hasResult = (int)fctx.HasResult();
@@ -55,6 +60,7 @@ int LuaMemberCallbackIndex(lua_State* L, std::string str_key)
 int LuaMemberCallbackNewIndex(lua_State* L, std::string str_key)
 {
     auto ctx = GetContextByState(L);
+    NativeProfilerScope profile(NativeProfilerKind::MemberSet, str_key);
 
     FunctionContext fctx(str_key, ctx->GetKind(), ctx, true, false, true);
     FunctionContext* fptr = &fctx;
@@ -67,6 +73,7 @@ int LuaMemberCallbackNewIndex(lua_State* L, std::string str_key)
     auto functionPostCalls = ctx->GetClassMemberPostCalls(str_key);
     bool stopExecution = false;
 
+    profile.HooksBegin();
     for (auto func : functionPreCalls)
     {
         reinterpret_cast<ScriptingClassFunctionCallback>(func.second)(fptr, data);
@@ -76,6 +83,7 @@ int LuaMemberCallbackNewIndex(lua_State* L, std::string str_key)
             break;
         }
     }
+    profile.HooksEnd();
 
     if (!stopExecution) {
         void* func = ctx->GetClassMemberCalls(str_key).second;
@@ -84,11 +92,13 @@ int LuaMemberCallbackNewIndex(lua_State* L, std::string str_key)
             cb(fptr, data);
         }
 
+        profile.HooksBegin();
         for (auto func : functionPostCalls)
         {
             reinterpret_cast<ScriptingClassFunctionCallback>(func.second)(fptr, data);
             if (fctx.ShouldStopExecution()) break;
         }
+        profile.HooksEnd();
     }
 
     int hasResult = (int)fctx.HasResult();
@@ -102,6 +112,7 @@ int LuaMemberCallbackNewIndex(lua_State* L, std::string str_key)
 void DotNetMemberCallback(EContext* ctx, CallContext& call_ctx)
 {
     std::string str_key = call_ctx.GetNamespace() + " " + call_ctx.GetFunction();
+    NativeProfilerScope profile(call_ctx.GetArgumentCount() > 2 ? NativeProfilerKind::MemberSet : NativeProfilerKind::MemberGet, str_key);
     FunctionContext fctx(str_key, ctx->GetKind(), ctx, &call_ctx, true, call_ctx.GetArgumentCount() > 2);
     FunctionContext* fptr = &fctx;
 
@@ -112,6 +123,7 @@ void DotNetMemberCallback(EContext* ctx, CallContext& call_ctx)
     ClassData* data = call_ctx.GetArgument<ClassData*>(1);
 
     if (call_ctx.GetArgumentCount() <= 2) {
+        profile.HooksBegin();
         for (auto func : functionPreCalls)
         {
             reinterpret_cast<ScriptingClassFunctionCallback>(func.first)(fptr, data);
@@ -121,6 +133,7 @@ void DotNetMemberCallback(EContext* ctx, CallContext& call_ctx)
                 break;
             }
         }
+        profile.HooksEnd();
 
         if (!stopExecution) {
             void* func = ctx->GetClassMemberCalls(str_key).first;
@@ -129,14 +142,17 @@ void DotNetMemberCallback(EContext* ctx, CallContext& call_ctx)
                 cb(fptr, data);
             }
 
+            profile.HooksBegin();
             for (auto func : functionPostCalls)
             {
                 reinterpret_cast<ScriptingClassFunctionCallback>(func.first)(fptr, data);
                 if (fctx.ShouldStopExecution()) break;
             }
+            profile.HooksEnd();
         }
     }
     else {
+        profile.HooksBegin();
         for (auto func : functionPreCalls)
         {
             reinterpret_cast<ScriptingClassFunctionCallback>(func.second)(fptr, data);
@@ -146,6 +162,7 @@ void DotNetMemberCallback(EContext* ctx, CallContext& call_ctx)
                 break;
             }
         }
+        profile.HooksEnd();
 
         if (!stopExecution) {
             void* func = ctx->GetClassMemberCalls(str_key).second;
@@ -154,11 +171,13 @@ void DotNetMemberCallback(EContext* ctx, CallContext& call_ctx)
                 cb(fptr, data);
             }
 
+            profile.HooksBegin();
             for (auto func : functionPostCalls)
             {
                 reinterpret_cast<ScriptingClassFunctionCallback>(func.second)(fptr, data);
                 if (fctx.ShouldStopExecution()) break;
             }
+            profile.HooksEnd();
         }
     }
 }
@@ -19,6 +19,7 @@ bool str_startswith(std::string value, std::string starting)
 int LuaClassIndex(lua_State* L)
 {
     auto ctx = GetContextByState(L);
+    EActiveStateScope active(ctx, L);
     std::string class_name = lua_tostring(L, lua_upvalueindex(1));
     std::string member_name = Stack<std::string>::getLua(ctx, 2);
 
@@ -35,6 +36,7 @@ int LuaClassIndex(lua_State* L)
 int LuaClassNewIndex(lua_State* L)
 {
     auto ctx = GetContextByState(L);
+    EActiveStateScope active(ctx, L);
     std::string class_name = lua_tostring(L, lua_upvalueindex(1));
     std::string member_name = Stack<std::string>::getLua(ctx, 2);
     std::string str_key = class_name + " " + member_name;
@@ -46,7 +48,9 @@ int LuaClassFunctionCall(lua_State* L)
 {
     std::string str_key = lua_tostring(L, lua_upvalueindex(1));
     auto ctx = GetContextByState(L);
+    EActiveStateScope active(ctx, L);
 
+    NativeProfilerScope profile(NativeProfilerKind::ClassFunction, str_key);
     auto splits = str_split(str_key, " ");
     FunctionContext fctx(str_key, ctx->GetKind(), ctx, splits[0] != splits[1], splits[0] == splits[1], false);
     FunctionContext* fptr = &fctx;
@@ -75,6 +79,7 @@ int LuaClassFunctionCall(lua_State* L)
 
     if (!data) return luaL_error(L, "You can't call a member function from a garbage collected variable. Save the variable somewhere before using it.");
 
+    profile.HooksBegin();
     for (void* func : functionPreCalls)
     {
         reinterpret_cast<ScriptingClassFunctionCallback>(func)(fptr, data);
@@ -84,6 +89,7 @@ int LuaClassFunctionCall(lua_State* L)
             break;
         }
     }
+    profile.HooksEnd();
 
     if (!stopExecution) {
         void* func = ctx->GetClassFunctionCall(str_key);
@@ -92,11 +98,13 @@ int LuaClassFunctionCall(lua_State* L)
             cb(fptr, data);
         }
 
+        profile.HooksBegin();
         for (void* func : functionPostCalls)
         {
             reinterpret_cast<ScriptingClassFunctionCallback>(func)(fptr, data);
             if (fctx.ShouldStopExecution()) break;
         }
+        profile.HooksEnd();
     }
 
     int hasResult = (int)fctx.HasResult();
@@ -109,6 +117,7 @@ int LuaClassFunctionCall(lua_State* L)
 void DotnetClassCallback(EContext* ctx, CallContext& call_ctx, bool bypassClassCheck)
 {
     std::string str_key = call_ctx.GetNamespace() + " " + call_ctx.GetFunction();
+    NativeProfilerScope profile(NativeProfilerKind::ClassFunction, str_key);
     auto splits = str_split(str_key, " ");
     FunctionContext fctx(str_key, ctx->GetKind(), ctx, &call_ctx, true, bypassClassCheck ? true : splits[0] == splits[1]);
     FunctionContext* fptr = &fctx;
@@ -152,6 +161,7 @@ void DotnetClassCallback(EContext* ctx, CallContext& call_ctx, bool bypassClassC
         data = (ClassData*)call_ctx.GetArgument<ClassData*>(1);
     }
 
+    profile.HooksBegin();
     for (void* func : functionPreCalls)
     {
         reinterpret_cast<ScriptingClassFunctionCallback>(func)(fptr, data);
@@ -161,6 +171,7 @@ void DotnetClassCallback(EContext* ctx, CallContext& call_ctx, bool bypassClassC
             break;
         }
     }
+    profile.HooksEnd();
 
     if (!stopExecution) {
         void* func = ctx->GetClassFunctionCall(str_key);
@@ -169,11 +180,13 @@ void DotnetClassCallback(EContext* ctx, CallContext& call_ctx, bool bypassClassC
             cb(fptr, data);
         }
 
+        profile.HooksBegin();
         for (void* func : functionPostCalls)
         {
             reinterpret_cast<ScriptingClassFunctionCallback>(func)(fptr, data);
             if (fctx.ShouldStopExecution()) break;
         }
+        profile.HooksEnd();
     }
 }
 
@@ -248,7 +261,6 @@ EValue CreateScriptingClassInstance(EContext* context, std::string class_name, s
 {
     if (context->GetKind() == ContextKinds::Lua)
     {
-        auto L = context->GetLuaState();
         ClassData* data = new ClassData(classdata, class_name, context);
         Stack<ClassData*>::pushLua(context, data);
         MarkDeleteOnGC(data);
@@ -13,11 +13,26 @@ private:
     std::map<std::string, std::any> m_classData;
     std::string m_className;
     EContext* m_ctx;
+    size_t m_nativeSize = 0;
 
 public:
     ClassData(std::map<std::string, std::any> data, std::string className, EContext* ctx);
+    ClassData(const ClassData& other);
+    // Would have to move the native size between contexts and drop the Lua userdatas pointing at this instance.
+    ClassData& operator=(const ClassData&) = delete;
     ~ClassData();
 
+    // Native memory owned by the instance (buffers, handles kept in its data) that no GC can see.
+    // It's tracked by the context's GetNativeMemoryUsage. On Dotnet contexts it's also part of GetMemoryUsage
+    // and reported to the .NET GC as memory pressure.
+    void SetNativeSize(size_t bytes);
+    size_t GetNativeSize();
+
+    EContext* GetContext();
+    // Called when the context is destroyed while the instance is still alive (e.g. a .NET copy finalized after
+    // its plugin unloaded), the destructor then doesn't call back into it.
+    void DetachContext();
+
     std::string GetClassname();
 
     void SetData(std::string key, std::any value);
@@ -1,6 +1,7 @@
 #include "../Engine.h"
 #include "../CHelpers.h"
 #include "../Helpers.h"
+#include "../Async.h"
 
 #include <regex>
 
@@ -8,7 +9,9 @@ int LuaFunctionCallback(lua_State* L)
 {
     std::string str_key = lua_tostring(L, lua_upvalueindex(1));
     auto ctx = GetContextByState(L);
+    EActiveStateScope active(ctx, L);
 
+    NativeProfilerScope profile(NativeProfilerKind::Function, str_key);
     FunctionContext fctx(str_key, ctx->GetKind(), ctx, false, false, false);
     FunctionContext* fptr = &fctx;
 
@@ -16,6 +19,7 @@ int LuaFunctionCallback(lua_State* L)
     auto functionPostCalls = ctx->GetFunctionPostCalls(str_key);
     bool stopExecution = false;
 
+    profile.HooksBegin();
     for (void* func : functionPreCalls) {
         reinterpret_cast<ScriptingFunctionCallback>(func)(fptr);
         if (fctx.ShouldStopExecution())
@@ -24,6 +28,7 @@ int LuaFunctionCallback(lua_State* L)
             break;
         }
     }
+    profile.HooksEnd();
 
     if (!stopExecution) {
         void* func = ctx->GetFunctionCall(str_key);
@@ -32,10 +37,17 @@ int LuaFunctionCallback(lua_State* L)
             cb(fptr);
         }
 
+        profile.HooksBegin();
         for (void* func : functionPostCalls) {
             reinterpret_cast<ScriptingFunctionCallback>(func)(fptr);
             if (fctx.ShouldStopExecution()) break;
         }
+        profile.HooksEnd();
+    }
+
+    if (auto op = fctx.GetSuspendedOperation()) {
+        ctx->SuspendAsync(L, op);
+        return lua_yieldk(L, 0, (lua_KContext)op.get(), LuaAsyncContinuation);
     }
 
     int hasResult = (int)fctx.HasResult();
@@ -46,6 +58,13 @@ int LuaFunctionCallback(lua_State* L)
 void DotNetFunctionCallback(EContext* ctx, CallContext& call_ctx)
 {
     std::string str_key = call_ctx.GetNamespace() + " " + call_ctx.GetFunction();
+    NativeProfilerScope profile(NativeProfilerKind::Function, str_key);
+
+    if (!ctx->HasFunctionHooks()) {
+        void* thunk = ctx->GetFunctionDotnetThunk(str_key);
+        if (thunk) return reinterpret_cast<DotnetFunctionThunk>(thunk)(ctx, call_ctx);
+    }
+
     FunctionContext fctx(str_key, ctx->GetKind(), ctx, &call_ctx, true, false);
     FunctionContext* fptr = &fctx;
 
@@ -53,6 +72,7 @@ void DotNetFunctionCallback(EContext* ctx, CallContext& call_ctx)
     auto functionPostCalls = ctx->GetFunctionPostCalls(str_key);
     bool stopExecution = false;
 
+    profile.HooksBegin();
     for (void* func : functionPreCalls) {
         reinterpret_cast<ScriptingFunctionCallback>(func)(fptr);
         if (fctx.ShouldStopExecution())
@@ -61,6 +81,7 @@ void DotNetFunctionCallback(EContext* ctx, CallContext& call_ctx)
             break;
         }
     }
+    profile.HooksEnd();
 
     if (!stopExecution) {
         void* func = ctx->GetFunctionCall(str_key);
@@ -69,76 +90,64 @@ void DotNetFunctionCallback(EContext* ctx, CallContext& call_ctx)
             cb(fptr);
         }
 
+        profile.HooksBegin();
         for (void* func : functionPostCalls) {
             reinterpret_cast<ScriptingFunctionCallback>(func)(fptr);
             if (fctx.ShouldStopExecution()) break;
         }
+        profile.HooksEnd();
     }
 }
 
 void AddScriptingFunction(EContext* ctx, std::string namespace_path, std::string function_name, ScriptingFunctionCallback callback)
 {
+    AddScriptingFunction(ctx, namespace_path, function_name, callback, LuaFunctionCallback);
+}
+
+void AddScriptingFunction(EContext* ctx, std::string namespace_path, std::string function_name, ScriptingFunctionCallback callback, lua_CFunction lua_callback)
+{
+    auto func_key = namespace_path + " " + function_name;
+    ctx->AddFunctionCall(func_key, reinterpret_cast<void*>(callback));
+
     if (ctx->GetKind() == ContextKinds::Lua)
     {
-        int pop_values = 0;
-        pop_values++;
-
         auto L = ctx->GetLuaState();
-        lua_pushglobaltable(L);
-
-        if (namespace_path != "_G")
-        {
-            auto paths = str_split(namespace_path, ".");
-            for (auto path : paths)
-            {
-                rawgetfield(L, -1, path.c_str());
-
-                if (lua_isnil(L, -1))
-                {
-                    lua_pop(L, 1);
-
-                    lua_newtable(L); // parent ns, ns
-
-                    lua_pushvalue(L, -1); // parent ns, ns, ns
-
-                    // ns.__metatable = ns
-                    lua_setmetatable(L, -2); // parent ns, ns
+        CHelpers::pushNamespace(L, namespace_path);
 
-                    // ns.__index = indexMetaMethod
-                    lua_pushcfunction(L, &CHelpers::indexMetaMethod);
-                    rawsetfield(L, -2, "__index"); // parent ns, ns
-
-                    // ns.__newindex = newindexMetaMethod
-                    lua_pushcfunction(L, &CHelpers::newindexStaticMetaMethod);
-                    rawsetfield(L, -2, "__newindex"); // pns, ns
+        lua_pushstring(L, func_key.c_str());
+        lua_pushcclosure(L, lua_callback, 1);
+        rawsetfield(L, -2, function_name.c_str());
 
-                    lua_newtable(L);                     // pns, ns, propget table (pg)
-                    lua_rawsetp(L, -2, getPropgetKey()); // ns [propgetKey] = pg. pns, ns
+        lua_pop(L, 1);
+    }
+}
 
-                    lua_newtable(L);                     // pns, ns, propset table (ps)
-                    lua_rawsetp(L, -2, getPropsetKey()); // ns [propsetKey] = ps. pns, ns
+void AddScriptingNamespace(EContext* ctx, const std::string& namespace_path, const std::map<std::string, ScriptingFunctionCallback>& functions, const std::map<std::string, EValue>& variables)
+{
+    std::string key_prefix = namespace_path + " ";
+    for (auto it = functions.begin(); it != functions.end(); ++it)
+        ctx->AddFunctionCall(key_prefix + it->first, reinterpret_cast<void*>(it->second));
 
-                    // pns [name] = ns
-                    lua_pushvalue(L, -1);             // pns, ns, ns
-                    rawsetfield(L, -3, path.c_str()); // pns, ns
-                }
+    if (ctx->GetKind() == ContextKinds::Lua)
+    {
+        auto L = ctx->GetLuaState();
+        CHelpers::pushNamespace(L, namespace_path, (int)(functions.size() + variables.size()));
 
-                pop_values++;
-            }
+        for (auto it = functions.begin(); it != functions.end(); ++it)
+        {
+            std::string func_key = key_prefix + it->first;
+            lua_pushlstring(L, func_key.data(), func_key.size());
+            lua_pushcclosure(L, LuaFunctionCallback, 1);
+            rawsetfield(L, -2, it->first.c_str());
         }
 
-        auto func_key = namespace_path + " " + function_name;
-        ctx->AddFunctionCall(func_key, reinterpret_cast<void*>(callback));
-
-        lua_pushstring(L, func_key.c_str());
-        lua_pushcclosure(L, LuaFunctionCallback, 1);
-        rawsetfield(L, -2, function_name.c_str());
+        for (auto it = variables.begin(); it != variables.end(); ++it)
+        {
+            const_cast<EValue&>(it->second).pushLua();
+            rawsetfield(L, -2, it->first.c_str());
+        }
 
-        lua_pop(L, pop_values);
-    }
-    else if (ctx->GetKind() == ContextKinds::Dotnet) {
-        auto func_key = namespace_path + " " + function_name;
-        ctx->AddFunctionCall(func_key, reinterpret_cast<void*>(callback));
+        lua_pop(L, 1);
     }
 }
 
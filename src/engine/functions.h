@@ -3,6 +3,7 @@
 
 #include "../Value.h"
 #include "../dotnet/host.h"
+#include "../dotnet/format.h"
 #include <vector>
 
 class FunctionContext
@@ -18,6 +19,7 @@ private:
 
     int returnRef = LUA_NOREF;
     bool stopExecution = false;
+    std::shared_ptr<EAsyncOperation> m_suspendedOn;
 
     int m_argc;
 
@@ -36,6 +38,14 @@ public:
     void StopExecution();
     bool ShouldStopExecution();
 
+    // Suspends the calling coroutine once the native returns, until `op` completes. Its values replace the
+    // native's results. Only possible for Lua natives called from a coroutine started with EContext::RunAsync,
+    // returns false otherwise, so the native can fall back to blocking.
+    bool Suspend(std::shared_ptr<EAsyncOperation> op);
+    // Same, with a new operation to complete later, or nullptr when the native can't suspend.
+    std::shared_ptr<EAsyncOperation> Suspend();
+    std::shared_ptr<EAsyncOperation> GetSuspendedOperation();
+
     void pushLuaResult()
     {
         if (returnRef == LUA_NOREF)
@@ -91,11 +101,8 @@ public:
             if (index < 0 || index + 1 > m_vals->GetArgumentCount() - (int)m_shouldSkipFirstArgument - (int)m_skipCreatedUData)
                 return "";
 
-            static char out[8192];
-            memset(out, 0, sizeof(out));
-            InterpretAsString(const_cast<void*>(m_vals->GetArgumentPtr(index + (int)m_shouldSkipFirstArgument + (int)m_skipCreatedUData)), m_vals->GetArgumentType(index + (int)m_shouldSkipFirstArgument + (int)m_skipCreatedUData), out, sizeof(out));
-
-            return std::string(out);
+            int argIndex = index + (int)m_shouldSkipFirstArgument + (int)m_skipCreatedUData;
+            return DotnetFormatValue(const_cast<void*>(m_vals->GetArgumentPtr(argIndex)), m_vals->GetArgumentType(argIndex));
         }
         else
             return "";
@@ -135,6 +142,7 @@ public:
         }
         else if (m_kind == ContextKinds::Dotnet)
         {
+            EDotnetArenaMarshalScope marshal;
             Stack<T>::pushDotnet(m_ctx, (CallContext*)m_vals, value, true);
         }
     }
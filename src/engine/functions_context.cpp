@@ -1,4 +1,5 @@
 #include "functions.h"
+#include "../Async.h"
 
 typedef void (*ScriptingFunctionCallback)(FunctionContext*);
 
@@ -58,6 +59,29 @@ bool FunctionContext::ShouldStopExecution()
     return stopExecution;
 }
 
+bool FunctionContext::Suspend(std::shared_ptr<EAsyncOperation> op)
+{
+    if (m_kind != ContextKinds::Lua || !op) return false;
+
+    lua_State* L = m_ctx->GetLuaState();
+    if (!lua_isyieldable(L) || !m_ctx->IsAsyncThread(L)) return false;
+
+    m_suspendedOn = op;
+    return true;
+}
+
+std::shared_ptr<EAsyncOperation> FunctionContext::Suspend()
+{
+    auto op = std::make_shared<EAsyncOperation>();
+    if (!Suspend(op)) return nullptr;
+    return op;
+}
+
+std::shared_ptr<EAsyncOperation> FunctionContext::GetSuspendedOperation()
+{
+    return m_suspendedOn;
+}
+
 int FunctionContext::GetArgumentsCount()
 {
     if (m_kind == ContextKinds::Lua)